@@ -5,6 +5,7 @@
 #include <cstdlib>
 #include <ctime>
 #include <cerrno>
+#include <climits>
 
 #include <fcntl.h>      // shm_open, O_*
 #include <sys/mman.h>   // mmap, munmap
@@ -119,11 +120,17 @@ void send_to_observer(const std::string &msg) {
         }
     }
 
-    // Пишем весь буфер (учтём возможные частичные записи)
+    // Пишем кадрами не длиннее PIPE_BUF, разрезая по строкам: такая запись в канал атомарна,
+    // и сообщения менеджера и рабочих в общем /tmp/treasure_fifo не перемешиваются
     const char* data = msg.c_str();
     size_t remaining = msg.size();
     while (remaining > 0) {
-        ssize_t w = write(fifo_fd, data, remaining);
+        size_t chunk = remaining;
+        if (chunk > PIPE_BUF) {
+            size_t nl = msg.rfind('\n', (data - msg.c_str()) + PIPE_BUF - 1);
+            chunk = nl != string::npos && msg.c_str() + nl >= data ? msg.c_str() + nl - data + 1 : PIPE_BUF;
+        }
+        ssize_t w = write(fifo_fd, data, chunk);
         if (w > 0) {
             data += w;
             remaining -= (size_t)w;
@@ -0,0 +1,189 @@
+#pragma once
+
+// ---------------- Архив отчётов ----------------
+// Двоичный файл только на дозапись: прогоны подряд, каждый выровнен по странице.
+// Прогон = ArchiveRunHeader + записи фиксированного размера + разреженный индекс
+// (одна запись ArchiveIndexEntry на ARCHIVE_INDEX_STRIDE отчётов: время первого и диапазон участков).
+// Записи отображаются mmap; заголовок обновляется на каждой записи, поэтому
+// незавершённый прогон (падение) тоже читается.
+// Пишут: manager_named (--archive) и IDZ_4 treasure (-a); читает archive_tool.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr uint64_t ARCHIVE_MAGIC = 0x3130484352415254ULL; // "TRARCH01"
+constexpr uint64_t ARCHIVE_INDEX_STRIDE = 1024;
+constexpr uint64_t ARCHIVE_PAGE = 4096;
+
+struct ArchiveRunHeader {
+    uint64_t magic;
+    uint32_t header_size;
+    uint32_t record_size;
+    uint64_t start_unix_ns;
+    uint64_t record_count;
+    uint64_t capacity;       // место под записи
+    uint64_t index_offset;   // от начала прогона, 0 — индекса нет
+    uint64_t index_count;
+    uint64_t run_size;       // байт прогона с выравниванием
+    int32_t num_sections;
+    int32_t num_groups;
+    int32_t source;          // 3 — IDZ_3 manager_named, 4 — IDZ_4 treasure
+    int32_t complete;
+};
+
+struct ArchiveRecord {
+    uint64_t t_ns;           // от начала прогона
+    int32_t section;
+    int32_t group_id;
+    int32_t pid;
+    int32_t search_ms;
+    uint8_t found;
+    uint8_t pad[7];
+};
+
+struct ArchiveIndexEntry {
+    uint64_t first_record;
+    uint64_t t_first_ns;
+    int32_t min_section;
+    int32_t max_section;
+};
+
+inline uint64_t archive_round(uint64_t x) {
+    return (x + ARCHIVE_PAGE - 1) / ARCHIVE_PAGE * ARCHIVE_PAGE;
+}
+
+// ---------------- Запись ----------------
+struct ArchiveWriter {
+    int fd = -1;
+    uint64_t base = 0;       // смещение прогона в файле
+    char *map = nullptr;
+    size_t map_size = 0;
+    timespec start{};
+    std::vector<ArchiveIndexEntry> index;
+};
+
+// (Пере)отображение прогона под capacity записей
+inline bool archive_map(ArchiveWriter &w, uint64_t capacity) {
+    size_t size = archive_round(sizeof(ArchiveRunHeader) + capacity * sizeof(ArchiveRecord));
+    if (ftruncate(w.fd, (off_t)(w.base + size)) == -1) return false;
+    void *m = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, w.fd, (off_t)w.base);
+    if (m == MAP_FAILED) return false;
+    if (w.map) munmap(w.map, w.map_size);
+    w.map = (char *)m;
+    w.map_size = size;
+    return true;
+}
+
+inline bool archive_open(ArchiveWriter &w, const std::string &path, uint64_t capacity, int num_sections,
+                         int num_groups, int source) {
+    w.fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (w.fd == -1) {
+        perror("open archive");
+        return false;
+    }
+    struct stat st;
+    if (fstat(w.fd, &st) == -1) {
+        perror("fstat archive");
+        close(w.fd);
+        w.fd = -1;
+        return false;
+    }
+    w.base = archive_round((uint64_t)st.st_size);
+    if (capacity < ARCHIVE_INDEX_STRIDE) capacity = ARCHIVE_INDEX_STRIDE;
+    if (!archive_map(w, capacity)) {
+        perror("mmap archive");
+        close(w.fd);
+        w.fd = -1;
+        return false;
+    }
+    ArchiveRunHeader *h = (ArchiveRunHeader *)w.map;
+    memset(h, 0, sizeof(*h));
+    timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    h->magic = ARCHIVE_MAGIC;
+    h->header_size = sizeof(ArchiveRunHeader);
+    h->record_size = sizeof(ArchiveRecord);
+    h->start_unix_ns = (uint64_t)wall.tv_sec * 1000000000ULL + wall.tv_nsec;
+    h->capacity = capacity;
+    h->run_size = w.map_size;
+    h->num_sections = num_sections;
+    h->num_groups = num_groups;
+    h->source = source;
+    clock_gettime(CLOCK_MONOTONIC, &w.start);
+    return true;
+}
+
+inline void archive_append(ArchiveWriter &w, int section, int group_id, int pid, int search_ms, bool found) {
+    if (w.fd == -1) return;
+    ArchiveRunHeader *h = (ArchiveRunHeader *)w.map;
+    if (h->record_count == h->capacity) {
+        uint64_t capacity = h->capacity * 2;
+        if (!archive_map(w, capacity)) {
+            perror("archive grow");
+            return;
+        }
+        h = (ArchiveRunHeader *)w.map;
+        h->capacity = capacity;
+        h->run_size = w.map_size;
+    }
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t t_ns = (uint64_t)(now.tv_sec - w.start.tv_sec) * 1000000000ULL + now.tv_nsec - w.start.tv_nsec;
+    ArchiveRecord *r = (ArchiveRecord *)(w.map + sizeof(ArchiveRunHeader)) + h->record_count;
+    memset(r, 0, sizeof(*r));
+    r->t_ns = t_ns;
+    r->section = section;
+    r->group_id = group_id;
+    r->pid = pid;
+    r->search_ms = search_ms;
+    r->found = found ? 1 : 0;
+    if (h->record_count % ARCHIVE_INDEX_STRIDE == 0) {
+        w.index.push_back({h->record_count, t_ns, section, section});
+    } else {
+        ArchiveIndexEntry &e = w.index.back();
+        e.min_section = std::min(e.min_section, section);
+        e.max_section = std::max(e.max_section, section);
+    }
+    h->record_count++;
+}
+
+// Дописываем индекс за записями, помечаем прогон завершённым и обрезаем лишнее место.
+// Если индекс записать не удалось, прогон остаётся незавершённым: archive_tool прочитает
+// его по record_count без индекса.
+inline void archive_close(ArchiveWriter &w) {
+    if (w.fd == -1) return;
+    ArchiveRunHeader h = *(ArchiveRunHeader *)w.map;
+    munmap(w.map, w.map_size);
+    w.map = nullptr;
+    uint64_t index_off = sizeof(ArchiveRunHeader) + h.record_count * sizeof(ArchiveRecord);
+    size_t index_bytes = w.index.size() * sizeof(ArchiveIndexEntry);
+    bool index_ok = true;
+    if (index_bytes) {
+        ssize_t n = pwrite(w.fd, w.index.data(), index_bytes, (off_t)(w.base + index_off));
+        index_ok = n == (ssize_t)index_bytes;
+        if (!index_ok) {
+            if (n == -1) perror("write archive index");
+            else fprintf(stderr, "write archive index: записано %zd из %zu байт\n", n, index_bytes);
+        }
+    }
+    if (index_ok) {
+        h.index_offset = index_off;
+        h.index_count = w.index.size();
+        h.run_size = archive_round(index_off + index_bytes);
+        h.complete = 1;
+    }
+    if (pwrite(w.fd, &h, sizeof(h), (off_t)w.base) != (ssize_t)sizeof(h)) perror("write archive header");
+    else if (index_ok && ftruncate(w.fd, (off_t)(w.base + h.run_size)) == -1) perror("ftruncate archive");
+    close(w.fd);
+    w.fd = -1;
+}
@@ -0,0 +1,245 @@
+// Чтение архива отчётов: запросы и воспроизведение прогона для observer.
+//
+//   ./archive_tool runs    <archive>
+//   ./archive_tool found   <archive> [run]
+//   ./archive_tool groups  <archive> [run]
+//   ./archive_tool range   <archive> <run> <from_ms> <to_ms>
+//   ./archive_tool section <archive> <run> <section>
+//   ./archive_tool replay  <archive> <run> [speed]
+//
+// Файл отображается целиком только на чтение; запросы по времени и по участку
+// используют разреженный индекс прогона и читают только нужные блоки записей.
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <signal.h>
+#include <dirent.h>
+#include <time.h>
+
+#include "archive_format.h"
+
+using namespace std;
+
+struct Run {
+    const ArchiveRunHeader *hdr;
+    const ArchiveRecord *records;
+    uint64_t count;
+    const ArchiveIndexEntry *index;   // nullptr у незавершённого прогона
+    uint64_t index_count;
+};
+
+// Разбор файла на прогоны; незавершённый (после падения) прогон читается по record_count.
+// Все размеры и смещения из заголовка сверяются с остатком файла: обрезанный или испорченный
+// архив обрывает разбор, а не приводит к чтению за концом отображения.
+vector<Run> load_runs(const char *base, size_t size) {
+    vector<Run> runs;
+    uint64_t off = 0;
+    while (size - off >= sizeof(ArchiveRunHeader)) {
+        const ArchiveRunHeader *h = (const ArchiveRunHeader *)(base + off);
+        uint64_t left = size - off;
+        if (h->magic != ARCHIVE_MAGIC || h->record_size != sizeof(ArchiveRecord) || h->run_size == 0) break;
+        if (h->header_size < sizeof(ArchiveRunHeader) || h->header_size > left ||
+            h->header_size % alignof(ArchiveRecord))
+            break;
+        Run r;
+        r.hdr = h;
+        r.records = (const ArchiveRecord *)(base + off + h->header_size);
+        uint64_t max_records = (left - h->header_size) / sizeof(ArchiveRecord);
+        r.count = min(h->record_count, max_records);
+        r.index = nullptr;
+        r.index_count = 0;
+        // индекс лежит за записями и целиком внутри файла; произведение не должно переполниться
+        uint64_t records_end = h->header_size + r.count * sizeof(ArchiveRecord);
+        if (h->complete && h->index_offset >= records_end && h->index_offset <= left &&
+            h->index_offset % alignof(ArchiveIndexEntry) == 0 &&
+            h->index_count <= (left - h->index_offset) / sizeof(ArchiveIndexEntry)) {
+            const ArchiveIndexEntry *idx = (const ArchiveIndexEntry *)(base + off + h->index_offset);
+            // блоки должны идти по возрастанию и не выходить за записи, иначе ищем без индекса
+            bool ok = true;
+            for (uint64_t k = 0; k < h->index_count && ok; ++k)
+                ok = idx[k].first_record < r.count && (k == 0 || idx[k].first_record > idx[k - 1].first_record);
+            if (ok) {
+                r.index = idx;
+                r.index_count = h->index_count;
+            }
+        }
+        runs.push_back(r);
+        // последний прогон может быть обрезан; archive_round от run_size <= left не переполнится
+        if (h->run_size > left) break;
+        off += archive_round(h->run_size);
+        if (off > size) break;
+    }
+    return runs;
+}
+
+// Границы блока индекса k в записях
+void block_bounds(const Run &r, uint64_t k, uint64_t &from, uint64_t &to) {
+    from = r.index ? r.index[k].first_record : 0;
+    to = r.index && k + 1 < r.index_count ? r.index[k + 1].first_record : r.count;
+}
+
+string format_record(const ArchiveRecord &rec) {
+    std::ostringstream oss;
+    oss << "t=" << rec.t_ns / 1000000 << "ms группа " << rec.group_id << " (pid=" << rec.pid << ") участок #"
+        << rec.section << ", поиск " << rec.search_ms << " ms" << (rec.found ? " => Сундук НАЙДЕН!" : " => пусто");
+    return oss.str();
+}
+
+void print_runs(const vector<Run> &runs) {
+    for (size_t i = 0; i < runs.size(); ++i) {
+        const ArchiveRunHeader *h = runs[i].hdr;
+        time_t start = (time_t)(h->start_unix_ns / 1000000000ULL);
+        char tbuf[64];
+        struct tm tm;
+        localtime_r(&start, &tm);
+        strftime(tbuf, sizeof(tbuf), "%Y-%m-%d %H:%M:%S", &tm);
+        uint64_t found = 0;
+        for (uint64_t k = 0; k < runs[i].count; ++k) found += runs[i].records[k].found;
+        uint64_t dur = runs[i].count ? runs[i].records[runs[i].count - 1].t_ns / 1000000 : 0;
+        cout << "run " << i << ": " << tbuf << (h->source == 4 ? " IDZ_4" : " IDZ_3") << ", групп " << h->num_groups
+             << ", участков " << h->num_sections << ", отчётов " << runs[i].count << ", найдено " << found
+             << ", длительность " << dur << " ms" << (h->complete ? "" : " (не завершён)") << "\n";
+    }
+}
+
+// Отправка строки всем наблюдателям (как в manager_named, без ожидания медленных)
+void send_to_observers(const string &msg) {
+    DIR *dp = opendir("/tmp");
+    if (!dp) return;
+    struct dirent *ent;
+    while ((ent = readdir(dp)) != nullptr) {
+        string name = ent->d_name;
+        if (name.find("treasure_observer_fifo_") != 0) continue;
+        int fd = open((string("/tmp/") + name).c_str(), O_WRONLY | O_NONBLOCK);
+        if (fd == -1) continue;
+        if (write(fd, msg.c_str(), msg.size()) == -1 && errno == EAGAIN)
+            cerr << "[Replay][WARN] FIFO " << name << " переполнен, сообщение пропущено\n";
+        close(fd);
+    }
+    closedir(dp);
+}
+
+static volatile sig_atomic_t g_stop = 0;
+void sigint_handler(int) {
+    g_stop = 1;
+}
+
+int main(int argc, char *argv[]) {
+    ios::sync_with_stdio(false);
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " runs|found|groups|range|section|replay <archive> [args]\n";
+        return 1;
+    }
+    string cmd = argv[1];
+    int fd = open(argv[2], O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1 || st.st_size == 0) {
+        perror("open archive");
+        return 1;
+    }
+    void *mem = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    vector<Run> runs = load_runs((const char *)mem, st.st_size);
+    if (runs.empty()) {
+        cerr << "В файле нет прогонов\n";
+        return 1;
+    }
+    // по умолчанию — последний прогон
+    size_t run_no = argc >= 4 ? (size_t)stoul(argv[3]) : runs.size() - 1;
+    if (run_no >= runs.size()) {
+        cerr << "Нет прогона " << run_no << "\n";
+        return 1;
+    }
+    const Run &r = runs[run_no];
+
+    if (cmd == "runs") {
+        print_runs(runs);
+    } else if (cmd == "found") {
+        for (uint64_t k = 0; k < r.count; ++k)
+            if (r.records[k].found) cout << format_record(r.records[k]) << "\n";
+    } else if (cmd == "groups") {
+        struct GroupStat {
+            uint64_t reports = 0, found = 0, search_ms = 0;
+        };
+        map<int, GroupStat> groups;
+        for (uint64_t k = 0; k < r.count; ++k) {
+            GroupStat &g = groups[r.records[k].group_id];
+            g.reports++;
+            g.found += r.records[k].found;
+            g.search_ms += (uint64_t)r.records[k].search_ms;
+        }
+        for (auto &kv : groups)
+            cout << "группа " << kv.first << ": отчётов " << kv.second.reports << ", найдено " << kv.second.found
+                 << ", среднее время поиска " << (kv.second.reports ? kv.second.search_ms / kv.second.reports : 0)
+                 << " ms\n";
+    } else if (cmd == "range" && argc >= 6) {
+        uint64_t from = stoull(argv[4]) * 1000000ULL, to = stoull(argv[5]) * 1000000ULL;
+        // время в прогоне не убывает: двоичный поиск по индексу, затем по записям блока
+        uint64_t k0 = 0;
+        if (r.index) {
+            uint64_t blk = upper_bound(r.index, r.index + r.index_count, from,
+                                       [](uint64_t t, const ArchiveIndexEntry &e) { return t < e.t_first_ns; }) -
+                           r.index;
+            k0 = blk > 0 ? r.index[blk - 1].first_record : 0;
+        }
+        const ArchiveRecord *first = lower_bound(r.records + k0, r.records + r.count, from,
+                                                 [](const ArchiveRecord &a, uint64_t t) { return a.t_ns < t; });
+        for (const ArchiveRecord *p = first; p < r.records + r.count && p->t_ns <= to; ++p)
+            cout << format_record(*p) << "\n";
+    } else if (cmd == "section" && argc >= 5) {
+        int section = stoi(argv[4]);
+        uint64_t blocks = r.index ? r.index_count : 1, scanned = 0;
+        for (uint64_t b = 0; b < blocks; ++b) {
+            if (r.index && (section < r.index[b].min_section || section > r.index[b].max_section)) continue;
+            uint64_t from, to;
+            block_bounds(r, b, from, to);
+            scanned += to - from;
+            for (uint64_t k = from; k < to; ++k)
+                if (r.records[k].section == section) cout << format_record(r.records[k]) << "\n";
+        }
+        cerr << "(просмотрено записей: " << scanned << " из " << r.count << ")\n";
+    } else if (cmd == "replay") {
+        // Воспроизведение прогона для observer с ускорением speed (по умолчанию x10)
+        double speed = argc >= 5 ? stod(argv[4]) : 10.0;
+        if (speed <= 0) speed = 10.0;
+        signal(SIGINT, sigint_handler);
+        signal(SIGPIPE, SIG_IGN);
+        timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (uint64_t k = 0; k < r.count && !g_stop; ++k) {
+            uint64_t due_ns = (uint64_t)(r.records[k].t_ns / speed);
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            uint64_t elapsed = (uint64_t)(now.tv_sec - t0.tv_sec) * 1000000000ULL + now.tv_nsec - t0.tv_nsec;
+            if (due_ns > elapsed) {
+                uint64_t wait = due_ns - elapsed;
+                timespec req{(time_t)(wait / 1000000000ULL), (long)(wait % 1000000000ULL)};
+                nanosleep(&req, nullptr);
+            }
+            string msg = "[Replay run " + to_string(run_no) + "] " + format_record(r.records[k]) + "\n";
+            cout << msg;
+            send_to_observers(msg);
+        }
+    } else {
+        cerr << "Неизвестная команда или не хватает аргументов: " << cmd << "\n";
+        return 1;
+    }
+    munmap(mem, st.st_size);
+    return 0;
+}
@@ -0,0 +1,54 @@
+// Пример подключаемого ядра для worker_named (CPU-bound).
+// "Поиск клада" на участке: многократное перемешивание байтов блока участка,
+// сундук найден, если итоговый хэш попал в нижние found_pct процентов.
+//
+// Сборка: g++ -std=c++17 -O2 -shared -fPIC -o kernel_pow.so kernel_pow.cpp
+// Аргумент ядра (--kernel-arg): "<проходов>[:<found_pct>]", по умолчанию "64:10".
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+static int g_passes = 64;
+static int g_found_pct = 10;
+
+static inline uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+extern "C" int init(const char *arg) {
+    if (arg && *arg) sscanf(arg, "%d:%d", &g_passes, &g_found_pct);
+    if (g_passes < 1) g_passes = 1;
+    return 0;
+}
+
+// Возвращает 1 — сундук найден, 0 — пусто, <0 — ошибка.
+// Результат (8 байт хэша) пишется прямо в общую область результатов.
+extern "C" int process_section(int section, const void *input, size_t input_len,
+                               void *result, size_t result_cap, size_t *result_len) {
+    const unsigned char *p = (const unsigned char *)input;
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ (uint64_t)section;
+    for (int pass = 0; pass < g_passes; ++pass) {
+        size_t i = 0;
+        for (; i + 8 <= input_len; i += 8) {
+            uint64_t w;
+            memcpy(&w, p + i, 8);
+            h = mix(h ^ w);
+        }
+        for (; i < input_len; ++i) h = mix(h ^ p[i]);
+        h = mix(h + (uint64_t)pass);
+    }
+    *result_len = 0;
+    if (result_cap >= sizeof(h)) {
+        memcpy(result, &h, sizeof(h));
+        *result_len = sizeof(h);
+    }
+    return (int)(h % 100) < g_found_pct ? 1 : 0;
+}
+
+extern "C" void fini() {}
@@ -16,6 +16,32 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <dirent.h>
+#include <climits>
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <deque>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <queue>
+#include <functional>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/syscall.h>  // SYS_gettid для трассы, perf_event_open
+#include <sys/statfs.h>   // statfs (hugetlbfs)
+#include <sys/ioctl.h>
+#include <sys/resource.h> // getrusage
+#include <linux/perf_event.h>
+#include <poll.h>
+
+#include "archive_format.h"
+#include "section_map.h"
 
 using namespace std;
 
@@ -24,12 +50,54 @@ void sigint_handler(int) {
     g_stop = 1;
 }
 
+// Эластичный пул: менеджер сам запускает и отзывает worker_named
+struct ElasticPool {
+    bool enabled = false;
+    string worker_path;        // путь к worker_named
+    int min_workers = 1;
+    int max_workers = 1;
+    vector<pid_t> children;    // запущенные менеджером рабочие
+    vector<pid_t> retiring;    // которым уже отправлен SIGUSR1
+    int last_processed = 0;
+    double rate = 0.0;         // отчётов/с (сглаженное)
+    timespec last_tick{};
+};
+
+double ts_diff_sec(const timespec &a, const timespec &b) {
+    return (double)(a.tv_sec - b.tv_sec) + (double)(a.tv_nsec - b.tv_nsec) / 1e9;
+}
+
 struct Report {
     pid_t group_pid;
     int group_id;
     int section;
     bool found;
     time_t t;
+    int search_ms;     // фактическая длительность поиска
+    int job_id;        // задание демона (0 — обычный запуск)
+    int result_len;    // байт результата ядра в области результатов (участок * result_size)
+    int covered;       // сколько участков учитывает запись: 1 или число пустых в сводке комбайнера
+};
+
+// Входной файл ядра: заголовок, таблица смещений (count + 1 штук, от начала данных)
+// и блоки участков подряд. Рабочие отображают его только на чтение и передают
+// ядру указатель прямо в отображение, без копирования.
+constexpr uint64_t INPUT_MAGIC = 0x31544e4953525454ULL; // "TTRSINT1"
+struct InputHeader {
+    uint64_t magic;
+    uint64_t count;
+};
+
+// Задания режима демона. Участки задания — [0, total), next — следующий к выдаче.
+constexpr int MAX_JOBS = 8;
+struct JobSlot {
+    int id;
+    int active;
+    int total;
+    int next;
+    int work_min_ms;   // профиль работы: время поиска участка
+    int work_max_ms;
+    int found_pct;     // вероятность найти сундук, %
 };
 
 struct Shared {
@@ -43,138 +111,2034 @@ struct Shared {
     int shutdown;
     int active_workers;
     int max_workers;
+    // режим демона: участки выдаются из таблицы заданий по кругу
+    int daemon;
+    int job_cursor;
+    JobSlot jobs[MAX_JOBS];
+    // сообщений, отсечённых фильтрами наблюдателей (рабочие добавляют при выходе)
+    unsigned long long observer_suppressed;
+    // порядок выдачи участков (планировщик по стоимости): order[next_section]
+    int use_order;
+    size_t order_offset;
+    // подключаемое ядро (dlopen) и общий входной файл; пустой путь — имитация sleep
+    char kernel_path[256];
+    char kernel_arg[64];
+    char input_path[256];
+    size_t results_offset;   // область результатов ядра: result_size байт на участок
+    int result_size;
+    // поколение кольца отчётов: 0 — массив reports ниже, N > 0 — сегмент /treasure_demo_ring_N
+    int ring_gen;
+    // сколько раз рабочий не нашёл свободного места в кольце сразу (для автоподбора размера)
+    unsigned long long slots_blocked;
+    // комбайнер рабочих: сводка пустых участков раз в combine_every штук или combine_ms мс; 0 — выключен
+    int combine_every;
+    int combine_ms;
+    // файл трассы (--trace), рабочие дописывают в него свои интервалы; пустой — трасса выключена
+    char trace_path[256];
+    // подложка сегмента (MapKind) и --prefault: рабочие повторяют madvise и заполнение у себя
+    int map_kind;
+    int map_prefault;
+    // карта состояния участков (2 бита на участок), 0 — нет (режим демона)
+    size_t section_offset;
+    // замеры пустых участков, ушедших в сводку комбайнера: int32 мс на участок, -1 — ещё не забран
+    // менеджером; 0 — нет (без --cost-file или без --combine)
+    size_t cost_offset;
     // flexible array of reports
     Report reports[1];
 };
 
-size_t shmsize_for(int buf_size) {
-    return sizeof(Shared) + (size_t)(buf_size - 1) * sizeof(Report);
-}
+// Таблица слотов рабочих: отдельный сегмент /treasure_demo_stats (создаёт менеджер).
+// Номер слота — плотный id группы 0..MAX_WORKER_SLOTS-1; слот занимается при подключении и
+// освобождается при выходе. Статистику слота пишет только его владелец (обычными store,
+// без RMW), поэтому менеджер и observer читают её без блокировок. Блок — ровно строка кэша.
+constexpr int MAX_WORKER_SLOTS = 64;
+struct alignas(64) WorkerStats {
+    int32_t pid;             // 0 — слот свободен
+    int32_t remote;          // 1 — удалённый рабочий, слот ведёт менеджер
+    uint64_t claimed;        // взято участков
+    uint64_t found;          // найдено сундуков
+    uint64_t busy_ns;        // время поиска
+    uint64_t blocked_ns;     // ожидание семафоров (участки, место в кольце, запись отчёта)
+    uint64_t heartbeat_ns;   // CLOCK_MONOTONIC последнего обновления
+    uint64_t attach_ns;
+};
+static_assert(sizeof(WorkerStats) == 64, "WorkerStats must fill one cache line");
+
+struct StatsTable {
+    WorkerStats slots[MAX_WORKER_SLOTS];
+};
+
+static const char *STATS_SHM = "/treasure_demo_stats";
+
+static inline uint64_t mono_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Единственный писатель: атомарный store, чтобы читатель не увидел разорванное значение
+static inline void stat_add(uint64_t &field, uint64_t v) {
+    __atomic_store_n(&field, field + v, __ATOMIC_RELAXED);
+}
+
+static inline void stat_touch(WorkerStats *st) {
+    __atomic_store_n(&st->heartbeat_ns, mono_ns(), __ATOMIC_RELAXED);
+}
+
+static void stat_reset(WorkerStats *st, int remote) {
+    __atomic_store_n(&st->remote, remote, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->claimed, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->found, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->busy_ns, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->blocked_ns, 0, __ATOMIC_RELAXED);
+    uint64_t now = mono_ns();
+    __atomic_store_n(&st->attach_ns, now, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->heartbeat_ns, now, __ATOMIC_RELAXED);
+}
+
+// Занимает наименьший свободный слот (CAS по pid). Слоты упавших локальных рабочих
+// (pid уже не существует) забираются повторно. -1 — свободных слотов нет.
+int stats_attach(StatsTable *tab, pid_t pid, int remote) {
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < MAX_WORKER_SLOTS; ++i) {
+            WorkerStats *st = &tab->slots[i];
+            int32_t cur = __atomic_load_n(&st->pid, __ATOMIC_ACQUIRE);
+            if (pass == 0 ? cur != 0
+                          : cur == 0 || st->remote || !(kill(cur, 0) == -1 && errno == ESRCH))
+                continue;
+            if (__atomic_compare_exchange_n(&st->pid, &cur, (int32_t)pid, false, __ATOMIC_ACQ_REL,
+                                            __ATOMIC_RELAXED)) {
+                stat_reset(st, remote);
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+void stats_detach(StatsTable *tab, int slot) {
+    if (!tab || slot < 0) return;
+    __atomic_store_n(&tab->slots[slot].pid, 0, __ATOMIC_RELEASE);
+}
+
+static StatsTable *g_stats = nullptr;
+
+// Создаёт таблицу слотов (менеджер); рабочие без неё не запускаются
+bool stats_create() {
+    shm_unlink(STATS_SHM);
+    int fd = shm_open(STATS_SHM, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) return false;
+    void *p = MAP_FAILED;
+    if (ftruncate(fd, sizeof(StatsTable)) == 0)
+        p = mmap(nullptr, sizeof(StatsTable), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(STATS_SHM);
+        return false;
+    }
+    g_stats = (StatsTable*)p;   // ftruncate обнулил все слоты
+    return true;
+}
+
+// Сводка по занятым слотам; читается без блокировок, значения — моментальный снимок
+string stats_dashboard(const StatsTable *tab) {
+    std::ostringstream oss;
+    char line[160];
+    uint64_t now = mono_ns();
+    // заголовок выровнен вручную: printf считает ширину в байтах, а не в символах UTF-8
+    oss << "слот  pid      вид     взято   нашёл   поиск,с    ждал,с  загр%  пульс,с\n";
+    for (int i = 0; i < MAX_WORKER_SLOTS; ++i) {
+        const WorkerStats &st = tab->slots[i];
+        int32_t pid = __atomic_load_n(&st.pid, __ATOMIC_ACQUIRE);
+        if (pid == 0) continue;
+        uint64_t busy = __atomic_load_n(&st.busy_ns, __ATOMIC_RELAXED);
+        uint64_t blocked = __atomic_load_n(&st.blocked_ns, __ATOMIC_RELAXED);
+        uint64_t attach = __atomic_load_n(&st.attach_ns, __ATOMIC_RELAXED);
+        uint64_t beat = __atomic_load_n(&st.heartbeat_ns, __ATOMIC_RELAXED);
+        double alive = now > attach ? (now - attach) / 1e9 : 0;
+        snprintf(line, sizeof(line), "%-5d %-8d %-4s %8llu %7llu %9.2f %9.2f %6.1f %8.1f\n", i, pid,
+                 __atomic_load_n(&st.remote, __ATOMIC_RELAXED) ? "сеть" : "shm",
+                 (unsigned long long)__atomic_load_n(&st.claimed, __ATOMIC_RELAXED),
+                 (unsigned long long)__atomic_load_n(&st.found, __ATOMIC_RELAXED), busy / 1e9, blocked / 1e9,
+                 alive > 0 ? 100.0 * busy / 1e9 / alive : 0.0, now > beat ? (now - beat) / 1e9 : 0.0);
+        oss << line;
+    }
+    return oss.str();
+}
+
+// Поток живой сводки Сильвера (--dashboard N): раз в N секунд печатает таблицу слотов
+// и прогресс по карте участков
+static volatile bool g_dashboard_stop = false;
+static uint64_t *g_section_map = nullptr;
+static int g_section_total = 0;
+void* dashboard_thread(void* arg) {
+    int interval = *(int*)arg;
+    while (!g_dashboard_stop) {
+        for (int t = 0; t < interval * 10 && !g_dashboard_stop; ++t) usleep(100000);
+        if (g_dashboard_stop) break;
+        string progress;
+        if (g_section_map) {
+            long long claimed, done;
+            section_count(g_section_map, g_section_total, claimed, done);
+            progress = "участки: обследовано " + to_string(done) + " из " + to_string(g_section_total) +
+                       ", в работе " + to_string(claimed) + "\n";
+        }
+        cout << "[Manager][dashboard]\n" + stats_dashboard(g_stats) + progress;
+    }
+    return nullptr;
+}
+
+// Трассировка (--trace у менеджера). Интервалы (claim, search, wait-slot, enqueue, wait,
+// dequeue, format, fanout) копятся в буфере своего потока без блокировок; при выходе процесс
+// дописывает их в общий файл в формате Chrome trace-event (chrome://tracing, Perfetto).
+// Время — CLOCK_MONOTONIC, общий для всех процессов машины: менеджер и рабочие на одной оси.
+constexpr size_t TRACE_MAX_SPANS = 1 << 20;   // на поток; сверх этого интервалы только считаются
+struct TraceSpan {
+    const char *name;
+    uint64_t t0_ns;
+    uint64_t dur_ns;
+    const char *arg_name;   // nullptr — без аргумента
+    int64_t arg;
+};
+
+struct TraceBuffer {
+    pid_t tid;
+    string thread_name;
+    vector<TraceSpan> spans;
+    uint64_t dropped = 0;
+};
+
+static bool g_trace = false;
+static pthread_mutex_t g_trace_lock = PTHREAD_MUTEX_INITIALIZER;   // только список буферов
+static vector<TraceBuffer*> g_trace_buffers;
+static thread_local TraceBuffer *t_trace = nullptr;
+
+static TraceBuffer *trace_buffer() {
+    if (!t_trace) {
+        t_trace = new TraceBuffer();
+        t_trace->tid = (pid_t)syscall(SYS_gettid);
+        t_trace->spans.reserve(4096);
+        pthread_mutex_lock(&g_trace_lock);
+        g_trace_buffers.push_back(t_trace);
+        pthread_mutex_unlock(&g_trace_lock);
+    }
+    return t_trace;
+}
+
+// Подпись потока в трассе
+void trace_thread(const string &name) {
+    if (g_trace) trace_buffer()->thread_name = name;
+}
+
+static inline uint64_t trace_begin() { return g_trace ? mono_ns() : 0; }
+
+void trace_end(const char *name, uint64_t t0, const char *arg_name = nullptr, int64_t arg = 0) {
+    if (!g_trace || t0 == 0) return;
+    uint64_t now = mono_ns();
+    TraceBuffer *b = trace_buffer();
+    if (b->spans.size() >= TRACE_MAX_SPANS) {
+        b->dropped++;
+        return;
+    }
+    b->spans.push_back({name, t0, now - t0, arg_name, arg});
+}
+
+// Файл трассы — JSON-массив событий без закрывающей скобки (формат это допускает), поэтому
+// процессы просто дописывают свои события. Запись одна, с O_APPEND: куски разных процессов
+// не перемешиваются. Вызывать, когда остальные потоки процесса уже не пишут интервалы.
+void trace_dump(const string &path, const string &process) {
+    if (!g_trace) return;
+    string out;
+    char line[512];
+    pid_t pid = getpid();
+    uint64_t dropped = 0;
+    snprintf(line, sizeof(line),
+             "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n", (int)pid,
+             (int)pid, process.c_str());
+    out += line;
+    pthread_mutex_lock(&g_trace_lock);
+    for (TraceBuffer *b : g_trace_buffers) {
+        if (!b->thread_name.empty()) {
+            snprintf(line, sizeof(line),
+                     "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+                     (int)pid, (int)b->tid, b->thread_name.c_str());
+            out += line;
+        }
+        for (const TraceSpan &s : b->spans) {
+            int n = snprintf(line, sizeof(line),
+                             "{\"ph\":\"X\",\"cat\":\"treasure\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                             s.name, (int)pid, (int)b->tid, s.t0_ns / 1e3, s.dur_ns / 1e3);
+            if (s.arg_name)
+                snprintf(line + n, sizeof(line) - n, ",\"args\":{\"%s\":%lld}},\n", s.arg_name, (long long)s.arg);
+            else
+                snprintf(line + n, sizeof(line) - n, "},\n");
+            out += line;
+        }
+        dropped += b->dropped;
+    }
+    pthread_mutex_unlock(&g_trace_lock);
+
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd == -1) {
+        perror("open trace");
+        return;
+    }
+    const char *data = out.data();
+    size_t left = out.size();
+    while (left > 0) {
+        ssize_t w = write(fd, data, left);
+        if (w == -1 && errno == EINTR) continue;
+        if (w <= 0) {
+            perror("write trace");
+            break;
+        }
+        data += w;
+        left -= (size_t)w;
+    }
+    close(fd);
+    if (dropped)
+        cerr << "[trace] " << process << ": буфер потока переполнен, не записано интервалов: " << dropped << "\n";
+}
+
+size_t shmsize_for(int buf_size) {
+    return sizeof(Shared) + (size_t)(buf_size - 1) * sizeof(Report);
+}
+
+// Таблица порядка выдачи лежит сразу за кольцом отчётов
+size_t order_offset_for(int buf_size) {
+    return (shmsize_for(buf_size) + alignof(int) - 1) / alignof(int) * alignof(int);
+}
+
+// Подложка сегмента /treasure_demo_shm. При миллионах участков таблица порядка и область
+// результатов занимают сотни мегабайт: на 4К-страницах каждый процесс платит page fault при
+// первом касании страницы и промахи TLB при случайном доступе к участкам.
+//   --huge-pages  файл на hugetlbfs (HUGETLB_DIR, нужен пул vm.nr_hugepages); если нельзя —
+//                 прозрачные huge pages для shmem (MADV_HUGEPAGE, shmem_enabled = advise/always)
+//   --prefault    все страницы выделяются при запуске менеджера, рабочие сразу заполняют
+//                 свои таблицы страниц
+//   --mlock       управляющая часть и кольцо отчётов закреплены в памяти
+enum MapKind { MAP_KIND_4K = 0, MAP_KIND_THP = 1, MAP_KIND_HUGETLB = 2 };
+static const char *HUGETLB_DIR = "/dev/hugepages";
+constexpr size_t THP_SIZE = 2u << 20;
+constexpr long HUGETLBFS_MAGIC_FS = 0x958458f6;
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23   // Linux 5.14+
+#endif
+
+struct MapOptions {
+    bool huge = false;
+    bool prefault = false;
+    bool lock = false;
+};
+
+string hugetlb_path(const string &shm_name) { return string(HUGETLB_DIR) + shm_name; }
+
+const char *map_kind_name(int kind) {
+    switch (kind) {
+        case MAP_KIND_HUGETLB: return "hugetlbfs";
+        case MAP_KIND_THP: return "THP";
+        default: return "4K";
+    }
+}
+
+// Размер страницы hugetlbfs в HUGETLB_DIR, 0 — не смонтирован
+size_t hugetlb_page_size() {
+    struct statfs sfs;
+    if (statfs(HUGETLB_DIR, &sfs) == -1 || (long)sfs.f_type != HUGETLBFS_MAGIC_FS) return 0;
+    return (size_t)sfs.f_bsize;
+}
+
+// Разрешены ли прозрачные huge pages для shmem (выбранный режим в квадратных скобках)
+bool shmem_thp_available() {
+    ifstream in("/sys/kernel/mm/transparent_hugepage/shmem_enabled");
+    string tok;
+    while (in >> tok)
+        if (tok.front() == '[') return tok != "[never]" && tok != "[deny]";
+    return false;
+}
+
+// Заполнение таблицы страниц: MADV_POPULATE_WRITE, на старых ядрах — чтение каждой страницы
+void prefault_range(void *p, size_t size) {
+    if (madvise(p, size, MADV_POPULATE_WRITE) == 0) return;
+    volatile const char *c = (volatile const char*)p;
+    for (size_t off = 0; off < size; off += 4096) (void)c[off];
+}
+
+// Создаёт сегмент name (как O_EXCL: занятое имя в /dev/shm или на hugetlbfs — ошибка EEXIST).
+// size округляется до страницы подложки; фактическая подложка — в kind.
+void *segment_create(const string &name, size_t &size, const MapOptions &mo, int &kind) {
+    string hpath = hugetlb_path(name);
+    int probe = shm_open(name.c_str(), O_RDONLY, 0);
+    if (probe != -1 || access(hpath.c_str(), F_OK) == 0) {
+        if (probe != -1) close(probe);
+        errno = EEXIST;
+        return MAP_FAILED;
+    }
+    size_t hp = mo.huge ? hugetlb_page_size() : 0;
+    if (hp) {
+        int fd = open(hpath.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd != -1) {
+            size_t sz = (size + hp - 1) / hp * hp;
+            void *p = MAP_FAILED;
+            // резерв huge-страниц берётся при mmap: пустой пул даёт ENOMEM здесь, а не SIGBUS потом
+            if (ftruncate(fd, (off_t)sz) == 0)
+                p = mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_SHARED | (mo.prefault ? MAP_POPULATE : 0), fd, 0);
+            close(fd);
+            if (p != MAP_FAILED) {
+                size = sz;
+                kind = MAP_KIND_HUGETLB;
+                return p;
+            }
+            unlink(hpath.c_str());
+        }
+    }
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) return MAP_FAILED;
+    bool thp = mo.huge && shmem_thp_available();
+    size_t sz = thp ? (size + THP_SIZE - 1) / THP_SIZE * THP_SIZE : size;
+    // с THP сначала madvise, потом заполнение — иначе страницы выделятся по 4К
+    int flags = MAP_SHARED | (mo.prefault && !thp ? MAP_POPULATE : 0);
+    void *p = MAP_FAILED;
+    if (ftruncate(fd, (off_t)sz) == 0) p = mmap(nullptr, sz, PROT_READ | PROT_WRITE, flags, fd, 0);
+    int err = errno;
+    close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        errno = err;
+        return MAP_FAILED;
+    }
+    if (thp) {
+        madvise(p, sz, MADV_HUGEPAGE);
+        if (mo.prefault) prefault_range(p, sz);
+    }
+    size = sz;
+    kind = thp ? MAP_KIND_THP : MAP_KIND_4K;
+    return p;
+}
+
+void segment_unlink(const string &name, int kind) {
+    if (kind == MAP_KIND_HUGETLB) unlink(hugetlb_path(name).c_str());
+    else shm_unlink(name.c_str());
+}
+
+// Отображение готового сегмента (так же открывает его рабочий): сначала hugetlbfs, потом /dev/shm
+void *segment_attach(const string &name, size_t &size) {
+    int fd = open(hugetlb_path(name).c_str(), O_RDWR);
+    if (fd == -1) fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd == -1) return MAP_FAILED;
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return MAP_FAILED;
+    }
+    void *p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p != MAP_FAILED) size = st.st_size;
+    return p;
+}
+
+// Подготовка отображения у рабочего по флагам менеджера в Shared. Заполняется только горячая часть
+// (управляющие поля и кольцо): таблицы участков уже выделил менеджер, на них у рабочего остаются
+// дешёвые minor faults, а заполнять сотни мегабайт до первого отчёта — дольше, чем их касаться.
+void segment_advise(void *p, size_t size, int kind, bool prefault, size_t hot) {
+    if (kind == MAP_KIND_THP) madvise(p, size, MADV_HUGEPAGE);
+    if (prefault) prefault_range(p, min(hot, size));
+}
+
+// Бенчмарк подложки (--bench-map): для каждого варианта создаём сегмент размера прогона,
+// дочерний процесс отображает его как рабочий, пишет первый отчёт и результат, затем пишет в
+// область результатов по разу на участок в случайном порядке. Промахи dTLB — perf_event_open
+// (в виртуалках и при perf_event_paranoid > 2 счётчика может не быть — тогда «н/д»).
+struct MapBenchResult {
+    double first_us;      // от открытия сегмента до записанного первого отчёта
+    double sweep_ms;
+    long minflt;          // minor faults рабочего за всё время
+    long long dtlb;       // промахи dTLB на обходе, -1 — нет счётчика
+};
+
+int perf_dtlb_open() {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+long minor_faults() {
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_minflt;
+}
+
+MapBenchResult map_bench_child(const string &name, size_t results_off, int num_sections, int result_size) {
+    MapBenchResult r{0, 0, 0, -1};
+    long f0 = minor_faults();
+    uint64_t t0 = mono_ns();
+    size_t size;
+    void *mem = segment_attach(name, size);
+    if (mem == MAP_FAILED) _exit(1);
+    Shared *sh = (Shared*)mem;
+    segment_advise(mem, size, sh->map_kind, sh->map_prefault,
+                   offsetof(Shared, reports) + (size_t)sh->buf_size * sizeof(Report));
+    unsigned char *results = (unsigned char*)mem + results_off;
+    Report first{};
+    first.group_pid = getpid();
+    first.section = 0;
+    first.covered = 1;
+    results[0] = 1;
+    sh->reports[0] = first;
+    __atomic_store_n(&sh->reports_prod_idx, 1, __ATOMIC_RELEASE);
+    r.first_us = (mono_ns() - t0) / 1e3;
+
+    int pfd = perf_dtlb_open();
+    uint64_t x = 0x9e3779b97f4a7c15ull;
+    uint64_t s0 = mono_ns();
+    if (pfd != -1) ioctl(pfd, PERF_EVENT_IOC_ENABLE, 0);
+    for (int i = 0; i < num_sections; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        results[(x % (uint64_t)num_sections) * result_size] += 1;
+    }
+    if (pfd != -1) {
+        ioctl(pfd, PERF_EVENT_IOC_DISABLE, 0);
+        long long v;
+        if (read(pfd, &v, sizeof(v)) == (ssize_t)sizeof(v)) r.dtlb = v;
+        close(pfd);
+    }
+    r.sweep_ms = (mono_ns() - s0) / 1e6;
+    r.minflt = minor_faults() - f0;
+    munmap(mem, size);
+    return r;
+}
+
+string map_bench_report(int buf_size, int num_sections, int result_size) {
+    string name = string("/treasure_demo_bench_") + to_string(getpid());
+    size_t results_off = (order_offset_for(buf_size) + (size_t)num_sections * sizeof(int) + 63) / 64 * 64;
+    size_t need = results_off + (size_t)num_sections * result_size;
+    struct Variant {
+        const char *label;
+        MapOptions mo;
+    };
+    vector<Variant> variants(4);
+    variants[0].label = "4K";
+    variants[1].label = "4K + prefault";
+    variants[1].mo.prefault = true;
+    variants[2].label = "huge";
+    variants[2].mo.huge = true;
+    variants[3].label = "huge + prefault";
+    variants[3].mo.huge = variants[3].mo.prefault = true;
+
+    std::ostringstream oss;
+    char line[200];
+    oss << "[bench-map] сегмент " << need / (1 << 20) << " МБ: " << num_sections << " участков, результат "
+        << result_size << " байт, кольцо " << buf_size << "\n";
+    oss << "вариант           подложка   создание,мс  первый отчёт,мкс  обход,мс  minor faults  промахи dTLB\n";
+    for (const Variant &v : variants) {
+        size_t size = need;
+        int kind = MAP_KIND_4K;
+        uint64_t t0 = mono_ns();
+        void *mem = segment_create(name, size, v.mo, kind);
+        double create_ms = (mono_ns() - t0) / 1e6;
+        if (mem == MAP_FAILED) {
+            oss << v.label << ": не удалось создать сегмент: " << strerror(errno) << "\n";
+            continue;
+        }
+        Shared *sh = (Shared*)mem;
+        sh->map_kind = kind;
+        sh->map_prefault = v.mo.prefault ? 1 : 0;
+        sh->buf_size = buf_size;
+        int pfd[2];
+        MapBenchResult r{};
+        bool ok = false;
+        if (pipe(pfd) == 0) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(pfd[0]);
+                MapBenchResult cr = map_bench_child(name, results_off, num_sections, result_size);
+                ssize_t w = write(pfd[1], &cr, sizeof(cr));
+                _exit(w == (ssize_t)sizeof(cr) ? 0 : 1);
+            }
+            close(pfd[1]);
+            if (pid > 0) {
+                ok = read(pfd[0], &r, sizeof(r)) == (ssize_t)sizeof(r);
+                waitpid(pid, nullptr, 0);
+            }
+            close(pfd[0]);
+        }
+        munmap(mem, size);
+        segment_unlink(name, kind);
+        if (!ok) {
+            oss << v.label << ": дочерний процесс не вернул результат\n";
+            continue;
+        }
+        string dtlb = r.dtlb < 0 ? "н/д" : to_string(r.dtlb);
+        snprintf(line, sizeof(line), "%-17s %-10s %11.2f %17.1f %9.2f %13ld %13s\n", v.label, map_kind_name(kind),
+                 create_ms, r.first_us, r.sweep_ms, r.minflt, dtlb.c_str());
+        oss << line;
+    }
+    if (!hugetlb_page_size() && !shmem_thp_available())
+        oss << "[bench-map] huge pages недоступны: нет hugetlbfs в " << HUGETLB_DIR
+            << " и THP для shmem выключен (shmem_enabled) — вариант huge совпадает с 4K\n";
+    return oss.str();
+}
+
+// Планировщик по стоимости: оценка времени поиска каждого участка (мс).
+// Оценки берутся из журнала прошлого запуска (--cost-file), уточняются по отчётам
+// и записываются обратно в тот же файл в конце прогона.
+// Участки без оценки в журнале по ходу прогона получают среднее измеренных соседей
+// (дорогие участки идут кучно); тогда ещё не выданные участки пересортировываются.
+constexpr int COST_SPREAD = 16;   // соседей с каждой стороны
+
+struct CostModel {
+    bool enabled = false;
+    string path;
+    vector<double> est;     // оценка, мс
+    vector<char> known;     // была ли оценка в журнале/отчёте
+    vector<int> actual;     // измерено в этом прогоне (-1 — нет)
+    vector<double> near_sum; // сумма измеренных соседей (для участков без оценки)
+    vector<int> near_cnt;
+    bool dirty = false;     // оценки невыданных участков менялись после последней сортировки
+    int resorts = 0;
+};
+
+// Формат журнала: строки "<участок> <мс>", '#' — комментарий
+void load_costs(CostModel &cm, int num_sections) {
+    cm.est.assign(num_sections, 0.0);
+    cm.known.assign(num_sections, 0);
+    cm.actual.assign(num_sections, -1);
+    cm.near_sum.assign(num_sections, 0.0);
+    cm.near_cnt.assign(num_sections, 0);
+    ifstream in(cm.path);
+    double sum = 0;
+    int cnt = 0;
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ls(line);
+        int sec;
+        double ms;
+        if (!(ls >> sec >> ms) || sec < 0 || sec >= num_sections) continue;
+        cm.est[sec] = ms;
+        cm.known[sec] = 1;
+        sum += ms;
+        cnt++;
+    }
+    // неизвестным участкам — среднее по известным (или середина диапазона 1-3 с)
+    double fallback = cnt > 0 ? sum / cnt : 2000.0;
+    for (int i = 0; i < num_sections; ++i)
+        if (!cm.known[i]) cm.est[i] = fallback;
+}
+
+void save_costs(const CostModel &cm) {
+    ofstream out(cm.path);
+    if (!out) {
+        cerr << "[Manager][WARN] не удалось записать журнал стоимостей " << cm.path << "\n";
+        return;
+    }
+    out << "# section cost_ms\n";
+    for (size_t i = 0; i < cm.est.size(); ++i)
+        if (cm.known[i]) out << i << " " << (long)cm.est[i] << "\n";
+}
+
+// Обновление оценки по пришедшему отчёту (экспоненциальное сглаживание)
+void update_cost(CostModel &cm, int section, int ms) {
+    if (section < 0 || section >= (int)cm.est.size() || ms < 0) return;
+    cm.actual[section] = ms;
+    cm.est[section] = cm.known[section] ? 0.5 * cm.est[section] + 0.5 * ms : ms;
+    cm.known[section] = 1;
+    int lo = max(0, section - COST_SPREAD), hi = min((int)cm.est.size() - 1, section + COST_SPREAD);
+    for (int j = lo; j <= hi; ++j) {
+        if (cm.known[j]) continue;
+        cm.near_sum[j] += ms;
+        cm.near_cnt[j]++;
+        cm.est[j] = cm.near_sum[j] / cm.near_cnt[j];
+        cm.dirty = true;
+    }
+}
+
+// Замеры участков, ушедших в сводки комбайнера (Shared::cost_offset): забираем и сбрасываем
+void harvest_costs(CostModel &cm, int32_t *samples, int n) {
+    for (int i = 0; i < n; ++i) {
+        int32_t ms = __atomic_load_n(&samples[i], __ATOMIC_RELAXED);
+        if (ms < 0) continue;
+        __atomic_store_n(&samples[i], -1, __ATOMIC_RELAXED);
+        update_cost(cm, i, ms);
+    }
+}
+
+// Порядок "самые долгие первыми" (LPT)
+vector<int> lpt_order(const vector<double> &cost) {
+    vector<int> order(cost.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = (int)i;
+    stable_sort(order.begin(), order.end(), [&](int a, int b) { return cost[a] > cost[b]; });
+    return order;
+}
+
+// Длительность прогона при жадной раздаче участков в заданном порядке workers группам
+double simulate_makespan(const vector<double> &cost, const vector<int> &order, int workers) {
+    priority_queue<double, vector<double>, greater<double>> free_at;
+    for (int i = 0; i < workers; ++i) free_at.push(0.0);
+    double makespan = 0;
+    for (int sec : order) {
+        double t = free_at.top() + cost[sec];
+        free_at.pop();
+        free_at.push(t);
+        makespan = max(makespan, t);
+    }
+    return makespan;
+}
+
+// measured_ms >= 0 — фактическая длительность прогона, печатается рядом с моделью
+string makespan_report(const vector<double> &cost, int workers, double measured_ms = -1) {
+    vector<int> index_order(cost.size());
+    for (size_t i = 0; i < index_order.size(); ++i) index_order[i] = (int)i;
+    double base = simulate_makespan(cost, index_order, workers);
+    double lpt = simulate_makespan(cost, lpt_order(cost), workers);
+    std::ostringstream oss;
+    oss << "[Manager][sched] makespan для " << workers << " групп (модель): по индексу " << (long)base
+        << " мс, longest-first " << (long)lpt << " мс, выигрыш "
+        << (base > 0 ? (base - lpt) * 100.0 / base : 0.0) << "%\n";
+    if (measured_ms >= 0)
+        oss << "[Manager][sched] makespan измеренный: " << (long)measured_ms
+            << " мс (от начала первого поиска до последнего отчёта; в модели нет накладных расходов)\n";
+    return oss.str();
+}
+
+// Пересортировка ещё не выданных участков по обновлённым оценкам (longest-first).
+// Хвост таблицы копируется и сортируется вне _mutex; за это время рабочие могли взять
+// участки с его начала — они уже не свободны в карте и выбрасываются из копии.
+void resort_pending(CostModel &cm, Shared *shared, void *mem, uint64_t *map, sem_t *section_mutex) {
+    int *order = (int *)((char *)mem + shared->order_offset);
+    int total = shared->total_sections;
+    sem_wait(section_mutex);
+    int from = min(shared->next_section, total);
+    vector<int> pending(order + from, order + total);
+    sem_post(section_mutex);
+    cm.dirty = false;
+    if (pending.size() < 2) return;
+    stable_sort(pending.begin(), pending.end(), [&](int a, int b) { return cm.est[a] > cm.est[b]; });
+
+    sem_wait(section_mutex);
+    int slot = shared->next_section;
+    for (int s : pending) {
+        if ((map[s / 32] >> (2 * (s % 32))) & 3) continue;   // взят, пока сортировали
+        if (slot >= total) break;
+        order[slot++] = s;
+    }
+    sem_post(section_mutex);
+    cm.resorts++;
+}
+
+string base_name = "/treasure_demo";
+
+string get_shm_name() {
+    return base_name + "_shm";
+}
+
+string get_sem_name(const string &sfx) {
+    return base_name + sfx;
+}
+
+// helper, чтобы анлинкнуть старые семафоры (игнорируем ошибки)
+void safe_sem_unlink(const char* name){
+    if (name == nullptr) return;
+    sem_unlink(name);
+}
+
+// FIFO / observer helpers
+// const char *FIFO_PATH = "/tmp/treasure_observer_fifo";
+
+// Игнорируем SIGPIPE, чтобы write() возвращал -1 с errno = EPIPE
+void init_fifo_signal_handling() {
+    signal(SIGPIPE, SIG_IGN);
+}
+
+// Попытка открыть FIFO для записи (non-blocking). Возвращает дескриптор или -1.
+int open_fifo_nonblocking(const std::string& path) {
+    // Убедимся, что FIFO существует; если нет — создадим (возможно, observer создаёт сам)
+    struct stat st;
+    if (stat(path.c_str(), &st) == -1) {
+        if (errno == ENOENT) {
+            // попытка создать FIFO; если другой процесс одновременно создаст — ok
+            if (mkfifo(path.c_str(), 0666) == -1) {
+                // если не удалось создать, это не фатально — просто сообщим и вернём -1
+                // (может создать observer)
+                // Не используем perror здесь, потому что мы будем логгировать через send_to_observer wrapper
+                return -1;
+            }
+        } else {
+            return -1;
+        }
+    }
+
+    // Открываем для записи в неблокирующем режиме
+    int fd = open(path.c_str(), O_WRONLY | O_NONBLOCK);
+    if (fd == -1) {
+        // Если нет читателя, open вернёт -1 с ENXIO — это нормальная ситуация
+        return -1;
+    }
+    return fd;
+}
+
+// Подписки наблюдателей. observer при запуске кладёт рядом со своим FIFO файл фильтра
+// /tmp/treasure_observer_filter_<pid> (types=, found_only=, groups=, sample=).
+// Публикатор проверяет фильтры ДО форматирования сообщения и записи в FIFO;
+// список подписчиков перечитывается только при изменении каталога /tmp,
+// дескрипторы FIFO держатся открытыми между сообщениями.
+enum EventType : unsigned {
+    EV_INFO = 1,      // служебные сообщения: запуск, завершение, ошибки, пул, сеть
+    EV_CLAIM = 2,     // рабочий взял участок
+    EV_SENT = 4,      // рабочий отправил отчёт
+    EV_REPORT = 8,    // Сильвер обработал отчёт
+    EV_ALL = 15
+};
+
+struct ObserverSub {
+    string fifo;
+    int fd = -1;
+    unsigned types = EV_ALL;
+    bool found_only = false;
+    vector<int> groups;          // пусто — все группы
+    unsigned long sample = 1;    // доставлять каждое sample-е подходящее событие
+    unsigned long matched = 0;
+    bool selected = false;       // выбран последним observers_select
+    bool lossless = false;       // не терять сообщения: при полном канале — в очередь
+};
+
+static vector<ObserverSub> g_subs;
+static struct timespec g_subs_mtime{};
+static struct timespec g_subs_scanned{};
+static bool g_subs_loaded = false;
+static unsigned long long g_suppressed = 0;   // сообщений, отсечённых фильтрами (в этом процессе)
+
+unsigned parse_event_types(const string &list) {
+    unsigned mask = 0;
+    std::stringstream ss(list);
+    string t;
+    while (getline(ss, t, ',')) {
+        if (t == "info") mask |= EV_INFO;
+        else if (t == "claim") mask |= EV_CLAIM;
+        else if (t == "sent") mask |= EV_SENT;
+        else if (t == "report") mask |= EV_REPORT;
+        else if (t == "all") mask |= EV_ALL;
+    }
+    return mask ? mask : (unsigned)EV_ALL;
+}
+
+void load_filter(ObserverSub &sub, const string &path) {
+    std::ifstream in(path);
+    string line;
+    while (getline(in, line)) {
+        size_t eq = line.find('=');
+        if (eq == string::npos) continue;
+        string key = line.substr(0, eq), val = line.substr(eq + 1);
+        if (key == "types") sub.types = parse_event_types(val);
+        else if (key == "found_only") sub.found_only = val == "1";
+        else if (key == "sample") sub.sample = max(1L, atol(val.c_str()));
+        else if (key == "lossless") sub.lossless = val == "1";
+        else if (key == "groups") {
+            std::stringstream ss(val);
+            string g;
+            while (getline(ss, g, ',')) if (!g.empty()) sub.groups.push_back(atoi(g.c_str()));
+        }
+    }
+}
+
+// Кадры для FIFO: каждая запись — целые строки общим размером не больше PIPE_BUF вместе с
+// префиксом номера события. write() такого размера в канал атомарен, поэтому записи разных
+// публикаторов не перемешиваются, а неблокирующая запись либо проходит целиком, либо EAGAIN.
+vector<string> frame_message(const std::string &msg, uint64_t seq) {
+    string prefix = seq ? "@" + to_string(seq - 1) + " " : "";
+    size_t room = PIPE_BUF - prefix.size() - 1;
+    vector<string> frames;
+    size_t pos = 0;
+    while (pos < msg.size()) {
+        size_t len = min(msg.size() - pos, room);
+        if (pos + len < msg.size()) {
+            size_t nl = msg.rfind('\n', pos + len - 1);
+            if (nl != string::npos && nl >= pos) len = nl - pos + 1;
+        }
+        string frame = prefix + msg.substr(pos, len);
+        if (frame.back() != '\n') frame += '\n';   // строка длиннее PIPE_BUF режется на части
+        frames.push_back(frame);
+        pos += len;
+    }
+    return frames;
+}
+
+// 0 — кадр записан целиком, иначе errno (EAGAIN — канал полон)
+int write_frame(int fd, const char *data, size_t len) {
+    ssize_t w;
+    do {
+        w = write(fd, data, len);
+    } while (w == -1 && errno == EINTR);
+    if (w == (ssize_t)len) return 0;
+    return w == -1 ? errno : EIO;
+}
+
+// Очередь недоставленных кадров наблюдателя в режиме без потерь (lossless=1 в фильтре).
+// Первые QUEUE_MEM_LIMIT байт держим в памяти, дальше — в отображённом файле (он сразу
+// удаляется из /tmp, поэтому после падения мусора не остаётся). Порядок: память, затем файл.
+constexpr size_t QUEUE_MEM_LIMIT = 64 * 1024;
+constexpr size_t SPILL_LIMIT = (size_t)256 << 20;
+struct ObserverQueue {
+    std::deque<string> mem;
+    size_t mem_bytes = 0;
+    int spill_fd = -1;
+    char *spill = nullptr;
+    size_t spill_cap = 0, spill_head = 0, spill_tail = 0;   // кадры [head, tail): uint32 длина + байты
+};
+
+static std::map<string, ObserverQueue> g_queues;
+static unsigned long long g_spilled = 0;       // кадров, прошедших через файл
+static unsigned long long g_spill_dropped = 0; // кадров, не поместившихся даже в файл
+
+bool queue_empty(const ObserverQueue &q) {
+    return q.mem.empty() && q.spill_head == q.spill_tail;
+}
+
+void queue_reset(ObserverQueue &q) {
+    if (q.spill) munmap(q.spill, q.spill_cap);
+    if (q.spill_fd != -1) close(q.spill_fd);
+    q = ObserverQueue();
+}
+
+bool spill_push(ObserverQueue &q, const string &frame) {
+    size_t need = sizeof(uint32_t) + frame.size();
+    if (q.spill_tail + need > q.spill_cap) {
+        if (q.spill_head > 0) {
+            // уже доставленное начало файла освобождаем сдвигом
+            memmove(q.spill, q.spill + q.spill_head, q.spill_tail - q.spill_head);
+            q.spill_tail -= q.spill_head;
+            q.spill_head = 0;
+        }
+        if (q.spill_tail + need > q.spill_cap) {
+            size_t cap = max(q.spill_cap * 2, (size_t)1 << 20);
+            while (cap < q.spill_tail + need) cap *= 2;
+            if (cap > SPILL_LIMIT) return false;
+            if (q.spill_fd == -1) {
+                char path[64];
+                snprintf(path, sizeof(path), "/tmp/treasure_spill_%d_XXXXXX", (int)getpid());
+                q.spill_fd = mkstemp(path);
+                if (q.spill_fd == -1) return false;
+                unlink(path);
+            }
+            if (ftruncate(q.spill_fd, (off_t)cap) == -1) return false;
+            void *p = mmap(nullptr, cap, PROT_READ | PROT_WRITE, MAP_SHARED, q.spill_fd, 0);
+            if (p == MAP_FAILED) return false;
+            if (q.spill) munmap(q.spill, q.spill_cap);
+            q.spill = (char*)p;
+            q.spill_cap = cap;
+        }
+    }
+    uint32_t len = (uint32_t)frame.size();
+    memcpy(q.spill + q.spill_tail, &len, sizeof(len));
+    memcpy(q.spill + q.spill_tail + sizeof(len), frame.data(), len);
+    q.spill_tail += need;
+    g_spilled++;
+    return true;
+}
+
+void queue_push(ObserverQueue &q, const string &frame) {
+    if (q.spill_head == q.spill_tail && q.mem_bytes + frame.size() <= QUEUE_MEM_LIMIT) {
+        q.mem.push_back(frame);
+        q.mem_bytes += frame.size();
+    } else if (!spill_push(q, frame)) {
+        g_spill_dropped++;
+    }
+}
+
+// Досылает очередь, пока канал принимает. 0 — канал полон или очередь пуста, иначе errno.
+int queue_flush(int fd, ObserverQueue &q) {
+    while (!q.mem.empty()) {
+        int err = write_frame(fd, q.mem.front().data(), q.mem.front().size());
+        if (err) return err == EAGAIN ? 0 : err;
+        q.mem_bytes -= q.mem.front().size();
+        q.mem.pop_front();
+    }
+    while (q.spill_head < q.spill_tail) {
+        uint32_t len;
+        memcpy(&len, q.spill + q.spill_head, sizeof(len));
+        int err = write_frame(fd, q.spill + q.spill_head + sizeof(len), len);
+        if (err) return err == EAGAIN ? 0 : err;
+        q.spill_head += sizeof(len) + len;
+    }
+    q.spill_head = q.spill_tail = 0;
+    return 0;
+}
+
+// Перечитываем подписчиков, если в /tmp что-то создавали/удаляли, и не реже раза в секунду:
+// грубые часы mtime могут не различить создание файла фильтра и FIFO
+void refresh_subscribers() {
+    struct stat st;
+    if (stat("/tmp", &st) == -1) return;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (g_subs_loaded && st.st_mtim.tv_sec == g_subs_mtime.tv_sec && st.st_mtim.tv_nsec == g_subs_mtime.tv_nsec &&
+        now.tv_sec - g_subs_scanned.tv_sec < 1)
+        return;
+    g_subs_mtime = st.st_mtim;
+    g_subs_scanned = now;
+    g_subs_loaded = true;
+
+    vector<ObserverSub> fresh;
+    DIR *dp = opendir("/tmp");
+    if (!dp) return;
+    struct dirent *ent;
+    while ((ent = readdir(dp)) != nullptr) {
+        string name = ent->d_name;
+        if (name.find("treasure_observer_fifo_") != 0) continue;
+        ObserverSub sub;
+        sub.fifo = "/tmp/" + name;
+        string pid = name.substr(strlen("treasure_observer_fifo_"));
+        load_filter(sub, "/tmp/treasure_observer_filter_" + pid);
+        // сохраняем открытый дескриптор и счётчик выборки уже известного подписчика
+        for (ObserverSub &old : g_subs)
+            if (old.fifo == sub.fifo) {
+                sub.fd = old.fd;
+                sub.matched = old.matched;
+                old.fd = -1;
+            }
+        fresh.push_back(sub);
+    }
+    closedir(dp);
+    for (ObserverSub &old : g_subs) {
+        if (old.fd != -1) close(old.fd);
+        bool alive = false;
+        for (const ObserverSub &sub : fresh) alive = alive || sub.fifo == old.fifo;
+        auto it = g_queues.find(old.fifo);
+        if (!alive && it != g_queues.end()) {
+            // наблюдатель исчез — недоставленное ему уже не нужно
+            queue_reset(it->second);
+            g_queues.erase(it);
+        }
+    }
+    g_subs.swap(fresh);
+}
+
+// Отбирает подписчиков, которым нужно событие. false — никому: сообщение можно не формировать.
+bool observers_select(unsigned type, int group_id, bool found) {
+    refresh_subscribers();
+    bool any = false;
+    for (ObserverSub &sub : g_subs) {
+        bool ok = (sub.types & type) && (!sub.found_only || found || type == EV_INFO);
+        if (ok && !sub.groups.empty() && group_id >= 0)
+            ok = find(sub.groups.begin(), sub.groups.end(), group_id) != sub.groups.end();
+        if (ok) ok = (sub.matched++ % sub.sample) == 0;
+        sub.selected = ok;
+        if (ok) any = true;
+        else g_suppressed++;
+    }
+    return any;
+}
+
+// Канал наблюдателя закрыт — забываем дескриптор и очередь
+void observer_broken(ObserverSub &sub, int err) {
+    if (err != EPIPE) std::cerr << "[ERROR] write to FIFO failed: " << strerror(err) << "\n";
+    close(sub.fd);
+    sub.fd = -1;
+    auto it = g_queues.find(sub.fifo);
+    if (it != g_queues.end()) {
+        queue_reset(it->second);
+        g_queues.erase(it);
+    }
+}
+
+void send_to_observer(const std::string& msg, ObserverSub &sub, uint64_t seq) {
+    // Если FIFO дескриптор не открыт, попробуем открыть
+    if (sub.fd == -1) sub.fd = open_fifo_nonblocking(sub.fifo);
+    if (sub.fd == -1) {
+        // Нет доступного FIFO/читателя — логируем в stderr (и остаёмся работать)
+        std::cerr << "[WARN] FIFO not available for observer; message not sent: "
+                    << (msg.size() > 200 ? msg.substr(0,200) + "..." : msg) ;
+        // ensure newline
+        if (msg.empty() || msg.back() != '\n') std::cerr << "\n";
+        return;
+    }
+
+    for (const string &frame : frame_message(msg, seq)) {
+        if (sub.lossless) {
+            // сначала досылаем накопленное, чтобы не нарушить порядок
+            ObserverQueue &q = g_queues[sub.fifo];
+            int err = queue_empty(q) ? 0 : queue_flush(sub.fd, q);
+            if (err) {
+                observer_broken(sub, err);
+                return;
+            }
+            if (!queue_empty(q)) {
+                queue_push(q, frame);
+                continue;
+            }
+        }
+        int err = write_frame(sub.fd, frame.data(), frame.size());
+        if (err == 0) continue;
+        if (err == EAGAIN || err == EWOULDBLOCK) {
+            if (sub.lossless) {
+                queue_push(g_queues[sub.fifo], frame);
+                continue;
+            }
+            // FIFO временно недоступен (буфер полон) — не блокируемся, логируем и отбрасываем сообщение
+            std::cerr << "[WARN] FIFO write would block, message dropped: "
+                      << (msg.size() > 200 ? msg.substr(0,200) + "..." : msg);
+            if (msg.empty() || msg.back() != '\n') std::cerr << "\n";
+            return;
+        }
+        // EPIPE (читатель ушёл), прочие ошибки — закрываем, при следующем сообщении откроем заново
+        observer_broken(sub, err);
+        return;
+    }
+}
+
+// Отправка уже сформированного сообщения подписчикам, отобранным последним observers_select
+void send_to_selected(const std::string &msg, uint64_t seq = 0) {
+    uint64_t t0 = trace_begin();
+    int n = 0;
+    for (ObserverSub &sub : g_subs)
+        if (sub.selected) {
+            send_to_observer(msg, sub, seq);
+            n++;
+        }
+    trace_end("fanout", t0, "observers", n);
+}
+
+// Досылка очередей медленных наблюдателей; вызывается из рабочих циклов и никогда не ждёт
+void observers_flush() {
+    for (ObserverSub &sub : g_subs) {
+        auto it = g_queues.find(sub.fifo);
+        if (it == g_queues.end() || queue_empty(it->second) || sub.fd == -1) continue;
+        int err = queue_flush(sub.fd, it->second);
+        if (err) observer_broken(sub, err);
+    }
+}
+
+bool observers_pending() {
+    for (auto &kv : g_queues)
+        if (!queue_empty(kv.second)) return true;
+    return false;
+}
+
+// Перед выходом: даём наблюдателям дочитать очередь, но не дольше timeout_ms
+void observers_drain(int timeout_ms) {
+    for (int t = 0; t < timeout_ms / 10 && observers_pending(); ++t) {
+        observers_flush();
+        if (observers_pending()) usleep(10000);
+    }
+}
+
+// Окно истории для наблюдателей, подключившихся посреди прогона. Отдельный сегмент
+// /treasure_demo_history (создаёт менеджер): кольцо последних событий, в которое каждый
+// публикатор пишет событие один раз, независимо от числа наблюдателей. Номер события
+// уходит в FIFO префиксом "@<seq> ", по нему observer склеивает историю с живым потоком.
+// Слот защищён seqlock: state = 2*seq+1 — пишется, 2*seq+2 — готов.
+constexpr int HISTORY_TEXT = 232;
+struct HistoryEntry {
+    uint64_t state;
+    uint32_t type;
+    int32_t group_id;
+    uint8_t found;
+    uint8_t pad;
+    uint16_t len;
+    char text[HISTORY_TEXT];
+};
+
+struct HistoryRing {
+    uint64_t head;           // номер следующего события
+    uint32_t slots;
+    uint32_t entry_size;
+    HistoryEntry entries[1];
+};
+
+static const char *HISTORY_SHM = "/treasure_demo_history";
+static HistoryRing *g_history = nullptr;
+
+// Возвращает номер события + 1 (0 — история выключена)
+uint64_t history_record(unsigned type, int group_id, bool found, const std::string &msg) {
+    if (!g_history) return 0;
+    uint64_t seq = __atomic_fetch_add(&g_history->head, 1, __ATOMIC_ACQ_REL);
+    HistoryEntry &e = g_history->entries[seq % g_history->slots];
+    __atomic_store_n(&e.state, 2 * seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    e.type = type;
+    e.group_id = group_id;
+    e.found = found ? 1 : 0;
+    e.len = (uint16_t)min(msg.size(), (size_t)HISTORY_TEXT);
+    memcpy(e.text, msg.data(), e.len);
+    __atomic_store_n(&e.state, 2 * seq + 2, __ATOMIC_RELEASE);
+    return seq + 1;
+}
+
+// Создаёт сегмент истории (менеджер); возвращает его размер, 0 — не удалось
+size_t history_create(int slots) {
+    size_t size = offsetof(HistoryRing, entries) + (size_t)slots * sizeof(HistoryEntry);
+    shm_unlink(HISTORY_SHM);
+    int fd = shm_open(HISTORY_SHM, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) return 0;
+    void *p = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0) p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(HISTORY_SHM);
+        return 0;
+    }
+    g_history = (HistoryRing*)p;
+    g_history->slots = (uint32_t)slots;
+    g_history->entry_size = sizeof(HistoryEntry);
+    __atomic_store_n(&g_history->head, 0, __ATOMIC_RELEASE);
+    return size;
+}
+
+// Нужно ли вообще формировать сообщение: его ждёт наблюдатель или окно истории.
+// Окно истории включается только явно (--history N у менеджера): иначе каждое событие
+// форматировалось бы, даже если ни один фильтр наблюдателей его не пропускает.
+// Отбирает подписчиков для следующего publish_selected.
+bool publish_wanted(unsigned type, int group_id, bool found) {
+    bool selected = observers_select(type, group_id, found);
+    return selected || g_history != nullptr;
+}
+
+void publish_selected(unsigned type, int group_id, bool found, const std::string &msg) {
+    uint64_t seq = history_record(type, group_id, found, msg);
+    bool any = false;
+    for (ObserverSub &sub : g_subs) any = any || sub.selected;
+    if (!any) return;
+    send_to_selected(msg, seq);
+}
+
+void publish(unsigned type, int group_id, bool found, const std::string &msg) {
+    if (publish_wanted(type, group_id, found)) publish_selected(type, group_id, found, msg);
+}
+
+// Служебное сообщение (EV_INFO) всем подписанным на него наблюдателям
+void send_to_observers(const std::string &msg) {
+    publish(EV_INFO, -1, false, msg);
+}
+
+// Запуск нового рабочего: fork + exec "<worker_path> open"
+pid_t spawn_worker(const string &path) {
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        execl(path.c_str(), path.c_str(), "open", (char*)nullptr);
+        perror("execl worker");
+        _exit(127);
+    }
+    return pid;
+}
+
+// Забираем завершившихся детей, чтобы не копить зомби
+void reap_children(ElasticPool &pool) {
+    for (size_t i = 0; i < pool.children.size();) {
+        int status;
+        pid_t r = waitpid(pool.children[i], &status, WNOHANG);
+        if (r == pool.children[i] || (r == -1 && errno == ECHILD)) {
+            // рабочий, упавший не отпустив слот
+            for (int k = 0; g_stats && k < MAX_WORKER_SLOTS; ++k)
+                if (__atomic_load_n(&g_stats->slots[k].pid, __ATOMIC_ACQUIRE) == pool.children[i])
+                    stats_detach(g_stats, k);
+            for (size_t j = 0; j < pool.retiring.size(); ++j) {
+                if (pool.retiring[j] == pool.children[i]) {
+                    pool.retiring.erase(pool.retiring.begin() + j);
+                    break;
+                }
+            }
+            pool.children.erase(pool.children.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+// Сколько участков ещё не выдано (в режиме демона — по всем активным заданиям).
+// Вызывать под section_mutex.
+int remaining_sections(const Shared *shared) {
+    if (!shared->daemon) return shared->total_sections - __atomic_load_n(&shared->next_section, __ATOMIC_RELAXED);
+    int remaining = 0;
+    for (int j = 0; j < MAX_JOBS; ++j)
+        if (shared->jobs[j].active) remaining += shared->jobs[j].total - shared->jobs[j].next;
+    return remaining;
+}
+
+// ---------------- Режим демона ----------------
+// Менеджер живёт долго, SHM, кольцо и семафоры создаются один раз, рабочие не завершаются
+// между заданиями, а ждут на семафоре _work (его значение = число невыданных участков).
+// Задания приходят строкой через Unix-сокет:
+//   JOB <num_sections> <buf_size> <work_min_ms> <work_max_ms> <found_pct>
+// Ответы: "ACCEPTED <id> setup_us=<мкс>" сразу и "DONE <id> ..." по завершении задания.
+const char *DAEMON_SOCKET = "/tmp/treasure_daemon.sock";
+
+// Локальная (не в SHM) часть задания: клиент и статистика
+struct DaemonJob {
+    int client_fd = -1;
+    int processed = 0;
+    int found = 0;
+    timespec start{};
+};
+
+struct Daemon {
+    Shared *shared = nullptr;
+    sem_t *section_mutex = nullptr;
+    sem_t *report_mutex = nullptr;
+    sem_t *slots_mutex = nullptr;
+    sem_t *items_mutex = nullptr;
+    sem_t *work_sem = nullptr;
+    int listen_fd = -1;
+    int capacity = 0;          // размер кольца в SHM; буфер задания не больше него
+    int next_job_id = 1;
+    DaemonJob jobs[MAX_JOBS];
+};
+
+void write_all(int fd, const string &msg) {
+    const char *p = msg.c_str();
+    size_t left = msg.size();
+    while (left > 0) {
+        ssize_t w = write(fd, p, left);
+        if (w == -1 && errno == EINTR) continue;
+        if (w <= 0) return;
+        p += w;
+        left -= (size_t)w;
+    }
+}
+
+// Регистрация задания в два шага, оба — из потока приёма (слоты занимает только он).
+// daemon_reserve выбирает свободный слот и номер задания, но задание ещё не активно:
+// рабочие его не видят, и ACCEPTED уходит клиенту раньше любого DONE.
+// daemon_activate заполняет слот и будит рабочих. Возвращает номер слота или -1.
+// Кольцо пусто: ни одного неразобранного отчёта и ни одного места, занятого рабочим под запись
+bool daemon_ring_empty(Daemon &d) {
+    int items = 0, free_slots = 0;
+    sem_getvalue(d.items_mutex, &items);
+    sem_getvalue(d.slots_mutex, &free_slots);
+    return items == 0 && free_slots == d.shared->buf_size;
+}
+
+int daemon_reserve(Daemon &d, int buf, int &job_id) {
+    Shared *shared = d.shared;
+    sem_wait(d.section_mutex);
+    int slot = -1;
+    bool idle = true;
+    for (int j = 0; j < MAX_JOBS; ++j) {
+        if (shared->jobs[j].active) idle = false;
+        else if (slot == -1) slot = j;
+    }
+    if (slot == -1) {
+        sem_post(d.section_mutex);
+        return -1;
+    }
+    // Размер кольца меняем только когда заданий нет и кольцо пусто: сброс индексов ниже
+    // потерял бы оставшиеся отчёты. Задание снимается после своего последнего отчёта, так что
+    // кольцо должно быть пусто; если нет — ждём Сильвера недолго, а потом оставляем прежний размер.
+    bool resize = idle && buf > 0 && buf != shared->buf_size;
+    for (int t = 0; resize && !daemon_ring_empty(d); ++t) {
+        if (t == 100) {
+            cerr << "[Manager][daemon][WARN] кольцо не опустело, размер остаётся " << shared->buf_size << "\n";
+            resize = false;
+            break;
+        }
+        sem_post(d.section_mutex);
+        usleep(10000);
+        sem_wait(d.section_mutex);
+    }
+    if (resize) {
+        if (buf > d.capacity) buf = d.capacity;
+        for (int k = shared->buf_size; k < buf; ++k) sem_post(d.slots_mutex);
+        // забираем только свободные места, без ожидания под _mutex (как в ring_resize):
+        // место, ещё занятое отставшим рабочим, остаётся в кольце
+        int taken = 0;
+        while (shared->buf_size - taken > buf && sem_trywait(d.slots_mutex) == 0) taken++;
+        if (buf < shared->buf_size) buf = shared->buf_size - taken;
+        sem_wait(d.report_mutex);
+        shared->reports_prod_idx = 0;
+        shared->reports_cons_idx = 0;
+        shared->buf_size = buf;
+        sem_post(d.report_mutex);
+    }
+    job_id = d.next_job_id++;
+    sem_post(d.section_mutex);
+    return slot;
+}
+
+void daemon_activate(Daemon &d, int slot, int job_id, int client_fd, int sections, int wmin, int wmax,
+                     int pct) {
+    Shared *shared = d.shared;
+    DaemonJob &local = d.jobs[slot];
+    local.client_fd = client_fd;
+    local.processed = 0;
+    local.found = 0;
+    clock_gettime(CLOCK_MONOTONIC, &local.start);
+
+    sem_wait(d.section_mutex);
+    JobSlot &job = shared->jobs[slot];
+    job.id = job_id;
+    job.total = sections;
+    job.next = 0;
+    job.work_min_ms = wmin;
+    job.work_max_ms = wmax < wmin ? wmin : wmax;
+    job.found_pct = pct;
+    job.active = 1;
+    sem_post(d.section_mutex);
+
+    // будим рабочих: по одному посту на участок
+    for (int k = 0; k < sections; ++k) sem_post(d.work_sem);
+}
+
+void *daemon_acceptor(void *arg) {
+    Daemon &d = *(Daemon *)arg;
+    while (true) {
+        // CLOEXEC: рабочие, запущенные пулом, иначе унаследуют сокет клиента, и тот не дождётся EOF
+        int cfd = accept4(d.listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (cfd == -1) {
+            if (errno == EINTR) continue;
+            break; // сокет закрыт при остановке демона
+        }
+        char buf[256];
+        size_t len = 0;
+        while (len < sizeof(buf) - 1) {
+            ssize_t r = read(cfd, buf + len, sizeof(buf) - 1 - len);
+            if (r == -1 && errno == EINTR) continue;
+            if (r <= 0) break;
+            len += (size_t)r;
+            if (memchr(buf, '\n', len)) break;
+        }
+        buf[len] = '\0';
+
+        timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        std::istringstream in(buf);
+        string cmd;
+        int sections = 0, bsize = 0, wmin = 1000, wmax = 3000, pct = 10;
+        in >> cmd >> sections >> bsize >> wmin >> wmax >> pct;
+        if (cmd != "JOB" || sections <= 0 || wmin < 0 || pct < 0 || pct > 100) {
+            write_all(cfd, "ERROR bad job\n");
+            close(cfd);
+            continue;
+        }
+        int job_id = 0;
+        int slot = daemon_reserve(d, bsize, job_id);
+        if (slot == -1) {
+            write_all(cfd, "BUSY\n");
+            close(cfd);
+            continue;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        long setup_us = (long)((t1.tv_sec - t0.tv_sec) * 1000000L + (t1.tv_nsec - t0.tv_nsec) / 1000);
+
+        // ACCEPTED — до активации: после неё задание может завершиться, а cfd — закрыться
+        std::ostringstream oss;
+        oss << "[Manager][daemon] принято задание " << job_id << ": участков " << sections
+            << ", работа " << wmin << "-" << wmax << " мс, шанс " << pct << "%, setup " << setup_us << " мкс\n";
+        cout << oss.str();
+        send_to_observers(oss.str());
+        write_all(cfd, "ACCEPTED " + to_string(job_id) + " setup_us=" + to_string(setup_us) + "\n");
+        daemon_activate(d, slot, job_id, cfd, sections, wmin, wmax, pct);
+    }
+    return nullptr;
+}
+
+// Учёт отчёта в режиме демона; по завершении задания отвечаем клиенту и освобождаем слот
+void daemon_on_report(Daemon &d, const Report &rep) {
+    for (int j = 0; j < MAX_JOBS; ++j) {
+        JobSlot &job = d.shared->jobs[j];
+        if (!job.active || job.id != rep.job_id) continue;
+        DaemonJob &local = d.jobs[j];
+        local.processed++;
+        if (rep.found) local.found++;
+        if (local.processed < job.total) return;
+
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        std::ostringstream oss;
+        oss << "DONE " << job.id << " processed=" << local.processed << " found=" << local.found
+            << " elapsed_ms=" << (long)(ts_diff_sec(now, local.start) * 1000) << "\n";
+        write_all(local.client_fd, oss.str());
+        close(local.client_fd);
+        local.client_fd = -1;
+
+        string msg = "[Manager][daemon] задание завершено: " + oss.str();
+        cout << msg;
+        send_to_observers(msg);
+
+        sem_wait(d.section_mutex);
+        job.active = 0;
+        sem_post(d.section_mutex);
+        return;
+    }
+}
+
+// Клиент: отправляет задание демону и печатает ответы до закрытия соединения
+int run_submit(int argc, char *argv[]) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " --submit <num_sections> [report_buffer_size] [--profile <min_ms>-<max_ms>:<pct>]\n";
+        return 1;
+    }
+    int sections = stoi(argv[2]);
+    int bsize = 0, wmin = 1000, wmax = 3000, pct = 10;
+    for (int i = 3; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--profile" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d-%d:%d", &wmin, &wmax, &pct) != 3) {
+                cerr << "Профиль задаётся как <min_ms>-<max_ms>:<pct>\n";
+                return 1;
+            }
+        } else if (i == 3 && arg.rfind("--", 0) != 0) {
+            bsize = stoi(arg);
+        } else {
+            cerr << "Неизвестный ключ: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, DAEMON_SOCKET, sizeof(addr.sun_path) - 1);
+    if (fd == -1 || connect(fd, (sockaddr *)&addr, sizeof(addr)) == -1) {
+        perror("connect (демон не запущен?)");
+        if (fd != -1) close(fd);
+        return 1;
+    }
+    timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    std::ostringstream req;
+    req << "JOB " << sections << " " << bsize << " " << wmin << " " << wmax << " " << pct << "\n";
+    write_all(fd, req.str());
+
+    char buf[256];
+    bool first = true;
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0 || (n == -1 && errno == EINTR)) {
+        if (n <= 0) continue;
+        if (first) {
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            cout << "[Submit] ответ за " << (long)(ts_diff_sec(t1, t0) * 1e6) << " мкс: ";
+            first = false;
+        }
+        cout.write(buf, n);
+    }
+    close(fd);
+    return 0;
+}
+
+// ---------------- Сетевой транспорт ----------------
+// Удалённые рабочие (worker_named connect <адрес>) получают участки пачками и
+// возвращают пачки отчётов. Кадр: NetHeader + payload, порядок байт — хоста (x86/ARM LE).
+//   HELLO   (worker -> manager): int32 pid
+//   PROFILE (manager -> worker): int32 work_min_ms, work_max_ms, found_pct
+//   REQ     (worker -> manager): uint32 число запрошенных пачек (кредиты, до depth вперёд)
+//   BATCH   (manager -> worker): int32 section[n]
+//   REPORTS (worker -> manager): NetReport[n]
+//   DONE    (manager -> worker): участков больше нет
+enum NetMsg : uint8_t { NET_HELLO = 1, NET_PROFILE = 2, NET_REQ = 3, NET_BATCH = 4, NET_REPORTS = 5, NET_DONE = 6 };
+
+struct __attribute__((packed)) NetHeader {
+    uint32_t len;   // байт payload
+    uint8_t type;
+};
+
+struct __attribute__((packed)) NetReport {
+    int32_t section;
+    int32_t search_ms;
+    uint8_t found;
+    uint8_t result_len;
+    uint8_t result[16];
+};
 
-string base_name = "/treasure_demo";
+// Самый длинный законный кадр — пачка отчётов на NET_MAX_BATCH участков. Кадр длиннее —
+// ошибка протокола: соединение рвётся до выделения памяти под payload.
+constexpr int NET_MAX_BATCH = 4096;
+constexpr uint32_t NET_MAX_PAYLOAD = NET_MAX_BATCH * sizeof(NetReport);
+// Больше пачек вперёд рабочий не получит, сколько бы ни запросил (--depth у рабочего ограничен тем же)
+constexpr int NET_MAX_CREDITS = 64;
 
-string get_shm_name() {
-    return base_name + "_shm";
+struct NetConn {
+    int fd = -1;
+    pid_t pid = 0;
+    int slot = -1;              // слот в таблице статистики = id группы
+    int credits = 0;            // сколько пачек рабочий готов принять
+    bool done_sent = false;
+    vector<char> in, out;
+    vector<int> outstanding;    // выданные, но не сданные участки
+};
+
+struct NetServer {
+    bool enabled = false;
+    string addr;
+    int listen_fd = -1;
+    int batch = 8;
+    vector<NetConn> conns;
+    vector<int> requeue;        // участки отвалившихся соединений
+    long batches_sent = 0;
+    long report_batches = 0;
+};
+
+// Адрес: "unix:/path" или "host:port"
+int net_listen(const string &addr) {
+    int fd;
+    if (addr.rfind("unix:", 0) == 0) {
+        string path = addr.substr(5);
+        unlink(path.c_str());
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un ua{};
+        ua.sun_family = AF_UNIX;
+        strncpy(ua.sun_path, path.c_str(), sizeof(ua.sun_path) - 1);
+        if (fd == -1 || bind(fd, (sockaddr *)&ua, sizeof(ua)) == -1) {
+            perror("bind unix");
+            if (fd != -1) close(fd);
+            return -1;
+        }
+    } else {
+        size_t colon = addr.rfind(':');
+        if (colon == string::npos) return -1;
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in ia{};
+        ia.sin_family = AF_INET;
+        ia.sin_port = htons((uint16_t)stoi(addr.substr(colon + 1)));
+        string host = addr.substr(0, colon);
+        if (inet_pton(AF_INET, host.empty() ? "0.0.0.0" : host.c_str(), &ia.sin_addr) != 1 ||
+            bind(fd, (sockaddr *)&ia, sizeof(ia)) == -1) {
+            perror("bind tcp");
+            close(fd);
+            return -1;
+        }
+    }
+    if (listen(fd, 64) == -1) {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
 }
 
-string get_sem_name(const string &sfx) {
-    return base_name + sfx;
+void net_queue(NetConn &c, uint8_t type, const void *payload, uint32_t len) {
+    NetHeader h{len, type};
+    const char *hp = (const char *)&h;
+    c.out.insert(c.out.end(), hp, hp + sizeof(h));
+    const char *pp = (const char *)payload;
+    if (len) c.out.insert(c.out.end(), pp, pp + len);
 }
 
-// helper, чтобы анлинкнуть старые семафоры (игнорируем ошибки)
-void safe_sem_unlink(const char* name){
-    if (name == nullptr) return;
-    sem_unlink(name);
+// Забираем до want участков из общей очереди (или из возвращённых отвалившимися соединениями)
+int net_claim(NetServer &net, Shared *shared, void *mem, sem_t *section_mutex, int want, vector<int> &out) {
+    while (want > 0 && !net.requeue.empty()) {
+        out.push_back(net.requeue.back());
+        net.requeue.pop_back();
+        want--;
+    }
+    uint64_t *map = (uint64_t *)((char *)mem + shared->section_offset);
+    if (!shared->use_order) {
+        // без планировщика участки берутся прямо из карты, как у локальных рабочих
+        int s;
+        while (want > 0 && (s = section_claim(map, shared->total_sections, &shared->next_section)) != -1) {
+            out.push_back(s);
+            want--;
+        }
+        return (int)out.size();
+    }
+    sem_wait(section_mutex);
+    while (want > 0 && shared->next_section < shared->total_sections) {
+        int slot = shared->next_section++;
+        int s = ((int *)((char *)mem + shared->order_offset))[slot];
+        section_take(map, s);
+        out.push_back(s);
+        want--;
+    }
+    sem_post(section_mutex);
+    return (int)out.size();
 }
 
-// FIFO / observer helpers
-// const char *FIFO_PATH = "/tmp/treasure_observer_fifo";
+// Участки, выданные по сети и ещё не сданные (включая возвращённые отвалившимися).
+// Пока они есть, DONE не шлётся никому: возвращённые участки берут только удалённые
+// рабочие (net_claim), локальные из карты их не видят.
+size_t net_in_flight(const NetServer &net) {
+    size_t n = net.requeue.size();
+    for (const NetConn &c : net.conns) n += c.outstanding.size();
+    return n;
+}
 
-// Игнорируем SIGPIPE, чтобы write() возвращал -1 с errno = EPIPE
-void init_fifo_signal_handling() {
-    signal(SIGPIPE, SIG_IGN);
+void net_drop(NetServer &net, size_t i, const char *why) {
+    NetConn &c = net.conns[i];
+    std::ostringstream oss;
+    oss << "[Manager][net] рабочий pid=" << c.pid << " отключён (" << why << "), возвращено участков: "
+        << c.outstanding.size() << "\n";
+    net.requeue.insert(net.requeue.end(), c.outstanding.begin(), c.outstanding.end());
+    stats_detach(g_stats, c.slot);
+    close(c.fd);
+    net.conns.erase(net.conns.begin() + i);
+    if (net.conns.empty() && !net.requeue.empty())
+        oss << "[Manager][net] удалённых рабочих не осталось: " << net.requeue.size()
+            << " участков ждут нового (worker_named connect " << net.addr << ")\n";
+    cout << oss.str();
+    send_to_observers(oss.str());
 }
 
-// Попытка открыть FIFO для записи (non-blocking). Возвращает дескриптор или -1.
-int open_fifo_nonblocking(const std::string& path) {
-    // Убедимся, что FIFO существует; если нет — создадим (возможно, observer создаёт сам)
-    struct stat st;
-    if (stat(path.c_str(), &st) == -1) {
-        if (errno == ENOENT) {
-            // попытка создать FIFO; если другой процесс одновременно создаст — ok
-            if (mkfifo(path.c_str(), 0666) == -1) {
-                // если не удалось создать, это не фатально — просто сообщим и вернём -1
-                // (может создать observer)
-                // Не используем perror здесь, потому что мы будем логгировать через send_to_observer wrapper
-                return -1;
-            }
-        } else {
-            return -1;
+// Одна итерация событийного цикла сети: принимаем соединения, читаем кадры, выдаём пачки.
+// Полученные отчёты складываются в reports.
+void net_poll(NetServer &net, Shared *shared, void *mem, sem_t *section_mutex, int timeout_ms,
+              vector<Report> &reports) {
+    vector<pollfd> pfds;
+    pfds.push_back({net.listen_fd, POLLIN, 0});
+    for (NetConn &c : net.conns)
+        pfds.push_back({c.fd, (short)(POLLIN | (c.out.empty() ? 0 : POLLOUT)), 0});
+    if (poll(pfds.data(), pfds.size(), timeout_ms) == -1) return;
+
+    if (pfds[0].revents & POLLIN) {
+        int cfd;
+        // CLOEXEC: рабочие, запущенные пулом, не должны держать сокеты удалённых рабочих после net_drop
+        while ((cfd = accept4(net.listen_fd, nullptr, nullptr, SOCK_CLOEXEC)) != -1) {
+            fcntl(cfd, F_SETFL, O_NONBLOCK);
+            int one = 1;
+            setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // для unix-сокета просто не сработает
+            NetConn c;
+            c.fd = cfd;
+            net.conns.push_back(c);
         }
     }
 
-    // Открываем для записи в неблокирующем режиме
-    int fd = open(path.c_str(), O_WRONLY | O_NONBLOCK);
-    if (fd == -1) {
-        // Если нет читателя, open вернёт -1 с ENXIO — это нормальная ситуация
-        return -1;
+    // conns могли пополниться — revents есть только у старых
+    for (size_t i = pfds.size() - 1; i >= 1; --i) {
+        NetConn &c = net.conns[i - 1];
+        short re = pfds[i].revents;
+        bool dead = false;
+        const char *why = "соединение закрыто";
+        if (re & (POLLIN | POLLHUP | POLLERR)) {
+            char buf[65536];
+            ssize_t n = 1;
+            // не больше двух кадров наперёд: остальное дочитаем на следующем витке
+            while (c.in.size() < 2 * (sizeof(NetHeader) + NET_MAX_PAYLOAD) &&
+                   (n = read(c.fd, buf, sizeof(buf))) > 0)
+                c.in.insert(c.in.end(), buf, buf + n);
+            if (n == 0 || (n == -1 && errno != EAGAIN && errno != EINTR)) dead = true;
+        }
+        // разбор кадров
+        size_t pos = 0;
+        while (c.in.size() - pos >= sizeof(NetHeader)) {
+            NetHeader h;
+            memcpy(&h, c.in.data() + pos, sizeof(h));
+            if (h.len > NET_MAX_PAYLOAD) {
+                dead = true;
+                why = "слишком длинный кадр";
+                break;
+            }
+            if (c.in.size() - pos - sizeof(h) < h.len) break;
+            const char *payload = c.in.data() + pos + sizeof(h);
+            if (h.type != NET_HELLO && c.slot == -1) {
+                dead = true;
+                why = "кадр до HELLO";
+                break;
+            }
+            if (h.type == NET_HELLO && h.len >= sizeof(int32_t)) {
+                int32_t pid;
+                memcpy(&pid, payload, sizeof(pid));
+                if (c.slot != -1 || pid <= 0) {
+                    // слот занимается по pid: 0 значит «свободен», повторный HELLO занял бы второй
+                    dead = true;
+                    why = "неверный HELLO";
+                    break;
+                }
+                c.pid = pid;
+                // id группы — плотный номер слота, как у локальных рабочих, а не pid
+                c.slot = stats_attach(g_stats, pid, 1);
+                if (c.slot == -1) {
+                    dead = true;
+                    why = "нет свободного слота";
+                    break;
+                }
+                // профиль работы и выданный слот (id группы)
+                int32_t profile[4] = {1000, 3000, 10, c.slot};
+                net_queue(c, NET_PROFILE, profile, sizeof(profile));
+                std::ostringstream oss;
+                oss << "[Manager][net] подключён удалённый рабочий pid=" << pid << ", слот " << c.slot << "\n";
+                cout << oss.str();
+                send_to_observers(oss.str());
+            } else if (h.type == NET_REQ && h.len >= sizeof(uint32_t)) {
+                uint32_t want;
+                memcpy(&want, payload, sizeof(want));
+                c.credits = (int)min<uint64_t>((uint64_t)c.credits + want, NET_MAX_CREDITS);
+            } else if (h.type == NET_REPORTS) {
+                net.report_batches++;
+                for (uint32_t off = 0; off + sizeof(NetReport) <= h.len; off += sizeof(NetReport)) {
+                    NetReport nr;
+                    memcpy(&nr, payload + off, sizeof(nr));
+                    // принимаем только отчёт по участку, выданному этому соединению и ещё не сданному:
+                    // чужой, повторный или вне карты участков ломал бы счётчик отчётов, карту и архив
+                    bool issued = false;
+                    if (nr.section >= 0 && nr.section < shared->total_sections)
+                        for (size_t k = 0; k < c.outstanding.size(); ++k)
+                            if (c.outstanding[k] == nr.section) {
+                                c.outstanding[k] = c.outstanding.back();
+                                c.outstanding.pop_back();
+                                issued = true;
+                                break;
+                            }
+                    if (!issued) {
+                        dead = true;
+                        why = "отчёт по невыданному участку";
+                        break;
+                    }
+                    Report rep{};
+                    rep.group_pid = c.pid;
+                    rep.group_id = c.slot;
+                    if (c.slot >= 0) {
+                        WorkerStats *st = &g_stats->slots[c.slot];
+                        if (nr.found) stat_add(st->found, 1);
+                        stat_add(st->busy_ns, (uint64_t)max(nr.search_ms, 0) * 1000000ull);
+                        stat_touch(st);
+                    }
+                    rep.section = nr.section;
+                    rep.found = nr.found != 0;
+                    rep.t = time(nullptr);
+                    rep.search_ms = nr.search_ms;
+                    rep.covered = 1;
+                    // результат удалённого ядра кладём в ту же область SHM, что и локальные
+                    if (nr.result_len > 0 && shared->results_offset) {
+                        int len = min((int)nr.result_len, min((int)sizeof(nr.result), shared->result_size));
+                        memcpy((char *)mem + shared->results_offset + (size_t)nr.section * shared->result_size,
+                               nr.result, len);
+                        rep.result_len = len;
+                    }
+                    reports.push_back(rep);
+                }
+                if (dead) break;
+            }
+            pos += sizeof(h) + h.len;
+        }
+        c.in.erase(c.in.begin(), c.in.begin() + pos);
+
+        // выдача пачек по кредитам
+        while (!dead && c.credits > 0) {
+            vector<int> sections;
+            if (net_claim(net, shared, mem, section_mutex, net.batch, sections) == 0) {
+                if (!c.done_sent && net_in_flight(net) == 0) {
+                    net_queue(c, NET_DONE, nullptr, 0);
+                    c.done_sent = true;
+                }
+                break;
+            }
+            c.credits--;
+            if (c.slot >= 0) stat_add(g_stats->slots[c.slot].claimed, sections.size());
+            c.outstanding.insert(c.outstanding.end(), sections.begin(), sections.end());
+            net_queue(c, NET_BATCH, sections.data(), (uint32_t)(sections.size() * sizeof(int)));
+            net.batches_sent++;
+        }
+
+        if (!dead && !c.out.empty()) {
+            ssize_t w = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+            if (w > 0) c.out.erase(c.out.begin(), c.out.begin() + w);
+            else if (w == -1 && errno != EAGAIN && errno != EINTR) dead = true;
+        }
+        if (dead) net_drop(net, i - 1, why);
     }
-    return fd;
 }
 
-void send_to_observer(const std::string& msg, const std::string& path) {
-    // Если FIFO дескриптор не открыт, попробуем открыть
-    int fifo_fd = open_fifo_nonblocking(path);
-    if (fifo_fd == -1) {
-        // Нет доступного FIFO/читателя — логируем в stderr (и остаёмся работать)
-        std::cerr << "[Manager][WARN] FIFO not available for observer; message not sent: "
-                    << (msg.size() > 200 ? msg.substr(0,200) + "..." : msg) ;
-        // ensure newline
-        if (msg.empty() || msg.back() != '\n') std::cerr << "\n";
-        return;
-    }
+// Политика масштабирования. Вызывается периодически из цикла Сильвера:
+// - очередь почти пуста и участки остались -> добавляем рабочего;
+// - кольцо почти заполнено (менеджер не успевает) или остался "хвост" -> отзываем одного.
+// За один тик меняем размер пула не больше чем на одного рабочего.
+void elastic_tick(ElasticPool &pool, Shared *shared, sem_t *section_mutex, sem_t *report_mutex) {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double dt = ts_diff_sec(now, pool.last_tick);
+    if (dt < 0.2) return;
+    pool.last_tick = now;
 
-    // Пишем весь буфер (учтём возможные частичные записи)
-    const char* data = msg.c_str();
-    size_t remaining = msg.size();
-    while (remaining > 0) {
-        ssize_t w = write(fifo_fd, data, remaining);
-        if (w > 0) {
-            data += w;
-            remaining -= (size_t)w;
-            continue;
+    reap_children(pool);
+
+    sem_wait(report_mutex);
+    int depth = shared->reports_prod_idx - shared->reports_cons_idx;
+    int processed = shared->processed_reports;
+    sem_post(report_mutex);
+
+    sem_wait(section_mutex);
+    int remaining = remaining_sections(shared);
+    sem_post(section_mutex);
+
+    double inst = (processed - pool.last_processed) / dt;
+    pool.last_processed = processed;
+    pool.rate = pool.rate == 0.0 ? inst : 0.7 * pool.rate + 0.3 * inst;
+
+    // active_workers учитывает и запущенных вручную рабочих; отзываемые ещё подключены, но уже не в счёт
+    int alive = shared->active_workers - (int)pool.retiring.size();
+    int mine = (int)(pool.children.size() - pool.retiring.size());
+    if (mine > alive) alive = mine; // дети, ещё не успевшие подключиться
+    int low_mark = shared->buf_size / 4;
+    int high_mark = shared->buf_size - shared->buf_size / 4;
+
+    std::ostringstream oss;
+    if (remaining > 0 && depth <= low_mark && alive < pool.max_workers && remaining > alive) {
+        pid_t pid = spawn_worker(pool.worker_path);
+        if (pid > 0) {
+            pool.children.push_back(pid);
+            oss << "[Manager][pool] +1 рабочий (pid=" << pid << "): активных " << alive + 1
+                << ", очередь " << depth << "/" << shared->buf_size << ", осталось участков " << remaining
+                << ", темп " << pool.rate << " отч/с\n";
         }
-        // w <= 0 => ошибка
-        if (w == -1) {
-            if (errno == EINTR) {
-                // прервано сигналом — попробуем снова
-                continue;
-            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // FIFO временно недоступен (буфер полон) — не блокируем manager, логируем и отбрасываем сообщение
-                std::cerr << "[Manager][WARN] FIFO write would block, message dropped: "
-                          << (msg.size() > 200 ? msg.substr(0,200) + "..." : msg);
-                if (msg.empty() || msg.back() != '\n') std::cerr << "\n";
-                return;
-            } else if (errno == EPIPE) {
-                // Читатель закрыл канал — закроем дескриптор и пометим как недоступный
-                std::cerr << "[Manager][WARN] FIFO broken (EPIPE). Closing fifo_fd and will retry later.\n";
-                close(fifo_fd);
-                fifo_fd = -1;
-                return;
-            } else {
-                // Прочие ошибки — логируем и закрываем дескриптор
-                std::cerr << "[Manager][ERROR] write to FIFO failed: " << strerror(errno) << "\n";
-                close(fifo_fd);
-                fifo_fd = -1;
-                return;
-            }
-        } else {
-            // w == 0 — возможно некорректная ситуация, закроем и выйдем
-            std::cerr << "[Manager][WARN] write returned 0, closing fifo_fd\n";
-            close(fifo_fd);
-            fifo_fd = -1;
-            return;
+    } else if (alive > pool.min_workers && (depth >= high_mark || remaining < alive)) {
+        for (size_t i = pool.children.size(); i-- > 0;) {
+            pid_t pid = pool.children[i];
+            bool already = false;
+            for (pid_t r : pool.retiring) already = already || r == pid;
+            if (already) continue;
+            kill(pid, SIGUSR1);
+            pool.retiring.push_back(pid);
+            oss << "[Manager][pool] -1 рабочий (pid=" << pid << "): активных " << alive - 1
+                << ", очередь " << depth << "/" << shared->buf_size << ", осталось участков " << remaining
+                << ", темп " << pool.rate << " отч/с\n";
+            break;
         }
     }
+    if (!oss.str().empty()) {
+        cout << oss.str();
+        send_to_observers(oss.str());
+    }
 }
 
-// Надёжная отправка сообщения в наблюдатель. Всегда возвращает true если хотя бы одно действие выполнено:
-// - сообщение напечатано в консоль до вызова этой функции (не здесь),
-// - функция пытается отправить в FIFO; при ошибке логирует в stderr и закрывает fifo_fd при необходимости.
-void send_to_observers(const std::string &msg) {
-    const char* dir = "/tmp";
-    DIR* dp = opendir(dir);
-    if (!dp) return;
+// Онлайн-изменение размера кольца отчётов. Поколение 0 — массив reports в основном сегменте,
+// каждое следующее — отдельный сегмент /treasure_demo_ring_<gen>. Смена поколения идёт под
+// report_mutex: непрочитанные отчёты переносятся в начало нового кольца, индексы сбрасываются,
+// ring_gen увеличивается. Рабочие сверяют ring_gen под тем же мьютексом перед записью и
+// переотображают кольцо.
+struct ReportRing {
+    Report *reports = nullptr;
+    size_t map_size = 0;   // 0 — поколение 0, отдельного отображения нет
+    int gen = 0;
+};
 
-    struct dirent* ent;
-    while ((ent = readdir(dp)) != nullptr) {
-        std::string name = ent->d_name;
-        if (name.find("treasure_observer_fifo_") == 0) {
-            std::string path = std::string("/tmp/") + name;
-            send_to_observer(msg, path);
+string ring_name(int gen) {
+    return base_name + "_ring_" + to_string(gen);
+}
+
+// Запросы оператора: SIGUSR1 — удвоить кольцо, SIGUSR2 — уменьшить вдвое
+static volatile sig_atomic_t g_ring_request = 0;
+void ring_signal_handler(int sig) {
+    g_ring_request = sig == SIGUSR1 ? 1 : -1;
+}
+
+// Меняет размер кольца; возвращает фактический новый размер (при уменьшении — не меньше,
+// чем позволяют отчёты в кольце и места, уже занятые рабочими) или -1 при ошибке.
+int ring_resize(Shared *shared, ReportRing &ring, int new_size, sem_t *report_mutex, sem_t *slots_mutex) {
+    while (sem_wait(report_mutex) == -1 && errno == EINTR) {}
+    int old_size = shared->buf_size;
+    if (new_size < old_size) {
+        // забираем только свободные места: занятые рабочими уже гарантированы старым размером
+        int taken = 0;
+        while (taken < old_size - new_size && sem_trywait(slots_mutex) == 0) taken++;
+        new_size = old_size - taken;
+    }
+    if (new_size == old_size) {
+        sem_post(report_mutex);
+        return old_size;
+    }
+
+    int gen = ring.gen + 1;
+    string name = ring_name(gen);
+    size_t size = (size_t)new_size * sizeof(Report);
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    void *p = MAP_FAILED;
+    if (fd != -1) {
+        if (ftruncate(fd, (off_t)size) == 0) p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    }
+    if (p == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        for (int k = new_size; k < old_size; ++k) sem_post(slots_mutex);   // вернуть взятые места
+        sem_post(report_mutex);
+        return -1;
+    }
+
+    // перенос непрочитанных отчётов
+    Report *fresh = (Report*)p;
+    int pending = shared->reports_prod_idx - shared->reports_cons_idx;
+    for (int k = 0; k < pending; ++k)
+        fresh[k] = ring.reports[(shared->reports_cons_idx + k) % old_size];
+    shared->reports_cons_idx = 0;
+    shared->reports_prod_idx = pending;
+    shared->buf_size = new_size;
+    __atomic_store_n(&shared->ring_gen, gen, __ATOMIC_RELEASE);
+
+    // имя старого поколения больше не нужно: рабочие со старым отображением перейдут на новое
+    if (ring.map_size) {
+        munmap(ring.reports, ring.map_size);
+        shm_unlink(ring_name(ring.gen).c_str());
+    }
+    ring.reports = fresh;
+    ring.map_size = size;
+    ring.gen = gen;
+    for (int k = old_size; k < new_size; ++k) sem_post(slots_mutex);
+    sem_post(report_mutex);
+    return new_size;
+}
+
+// Автоподбор размера: если рабочие за секунду заметно чаще упираются в полное кольцо —
+// удваиваем (до max_size); если упоров давно нет и кольцо почти пусто — уменьшаем вдвое (до min_size).
+struct RingTuner {
+    bool enabled = false;
+    int min_size = 0;
+    int max_size = 65536;
+    unsigned long long last_blocked = 0;
+    int calm_ticks = 0;
+    timespec last{};
+};
+
+void ring_tick(RingTuner &t, Shared *shared, ReportRing &ring, sem_t *report_mutex, sem_t *slots_mutex) {
+    int request = g_ring_request;
+    g_ring_request = 0;
+    int target = 0;
+    const char *why = nullptr;
+    if (request > 0) {
+        target = shared->buf_size * 2;
+        why = "по запросу (SIGUSR1)";
+    } else if (request < 0) {
+        target = max(1, shared->buf_size / 2);
+        why = "по запросу (SIGUSR2)";
+    } else if (t.enabled) {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec - t.last.tv_sec < 1) return;
+        t.last = now;
+        unsigned long long blocked = __atomic_load_n(&shared->slots_blocked, __ATOMIC_RELAXED);
+        unsigned long long delta = blocked - t.last_blocked;
+        t.last_blocked = blocked;
+        int depth = shared->reports_prod_idx - shared->reports_cons_idx;
+        // порог: хотя бы половина рабочих за секунду ждала место
+        if (delta > 0 && delta * 2 >= (unsigned long long)max(shared->active_workers, 1) &&
+            shared->buf_size < t.max_size) {
+            target = min(shared->buf_size * 2, t.max_size);
+            why = "рабочие ждут место в кольце";
+            t.calm_ticks = 0;
+        } else if (delta == 0 && depth < shared->buf_size / 8 && ++t.calm_ticks >= 10 &&
+                   shared->buf_size / 2 >= t.min_size) {
+            target = shared->buf_size / 2;
+            why = "кольцо долго почти пусто";
+            t.calm_ticks = 0;
         }
     }
-    closedir(dp);
+    if (!why) return;
+
+    int old_size = shared->buf_size;
+    uint64_t t0 = trace_begin();
+    int got = ring_resize(shared, ring, target, report_mutex, slots_mutex);
+    trace_end("ring-resize", t0, "size", got);
+    std::ostringstream oss;
+    if (got == -1)
+        oss << "[Manager][ring] не удалось создать поколение " << ring.gen + 1 << ": " << strerror(errno) << "\n";
+    else if (got != old_size)
+        oss << "[Manager][ring] размер кольца " << old_size << " -> " << got << " (" << why << "), поколение "
+            << ring.gen << "\n";
+    else
+        return;
+    cout << oss.str();
+    send_to_observers(oss.str());
 }
 
 int main(int argc, char* argv[]) {
@@ -183,25 +2147,205 @@ int main(int argc, char* argv[]) {
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
 
+    if (argc >= 2 && string(argv[1]) == "--submit") return run_submit(argc, argv);
+
+    // --daemon <num_groups> [report_buffer_size] [...]: участки приходят заданиями
+    bool daemon_mode = argc >= 2 && string(argv[1]) == "--daemon";
     if (argc < 3) {
-        cerr << "Usage: " << argv[0] << " <num_groups> <num_sections> [report_buffer_size]\n";
+        cerr << "Usage: " << argv[0] << " <num_groups> <num_sections> [report_buffer_size]"
+             << " [--spawn <worker_path>] [--min-workers N]"
+             << " [--cost-file <path>] [--bench-sched]"
+             << " [--kernel <lib.so> --input <file> [--kernel-arg <arg>] [--result-size N]]"
+             << " [--listen <host:port|unix:path> [--batch N]] [--archive <file>] [--quiet]"
+             << " [--history N] [--dashboard <sec>] [--ring-auto [--ring-max N]]"
+             << " [--combine N[:ms]]\n"
+             << "       " << argv[0] << " --daemon <num_groups> [report_buffer_size] [--spawn ...]\n"
+             << "       " << argv[0] << " --submit <num_sections> [report_buffer_size] [--profile <min_ms>-<max_ms>:<pct>]\n";
         return 1;
     }
 
-    int num_groups = stoi(argv[1]);
-    int num_sections = stoi(argv[2]);
+    // в обоих вариантах необязательный размер буфера стоит на месте argv[3]
+    int num_groups = stoi(argv[daemon_mode ? 2 : 1]);
+    int num_sections = daemon_mode ? 0 : stoi(argv[2]);
     int buf_size = 128;
-    if (argc >= 4) buf_size = stoi(argv[3]);
-    if (num_groups <= 0 || num_sections <= 0 || buf_size <= 0) {
+    ElasticPool pool;
+    CostModel costs;
+    bool bench_sched = false;
+    bool bench_map = false;
+    MapOptions map_opts;   // --huge-pages, --prefault, --mlock
+    string kernel_path, kernel_arg, input_path;
+    int result_size = 64;
+    NetServer net;
+    string archive_path;
+    bool quiet = false;   // не печатать каждый отчёт в консоль Сильвера
+    int history_slots = 0;     // окно истории для поздних наблюдателей, 0 — выключено
+    int dashboard_sec = 0;     // период живой сводки по слотам рабочих
+    RingTuner tuner;
+    int combine_every = 0, combine_ms = 500;   // --combine N[:ms]
+    string trace_path;                          // --trace <файл>: интервалы в формате Chrome trace-event
+    for (int i = 3; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--spawn" && i + 1 < argc) {
+            pool.enabled = true;
+            pool.worker_path = argv[++i];
+        } else if (arg == "--min-workers" && i + 1 < argc) {
+            pool.min_workers = stoi(argv[++i]);
+        } else if (arg == "--cost-file" && i + 1 < argc) {
+            costs.enabled = true;
+            costs.path = argv[++i];
+        } else if (arg == "--kernel" && i + 1 < argc) {
+            kernel_path = argv[++i];
+        } else if (arg == "--kernel-arg" && i + 1 < argc) {
+            kernel_arg = argv[++i];
+        } else if (arg == "--input" && i + 1 < argc) {
+            input_path = argv[++i];
+        } else if (arg == "--result-size" && i + 1 < argc) {
+            result_size = stoi(argv[++i]);
+        } else if (arg == "--listen" && i + 1 < argc) {
+            net.enabled = true;
+            net.addr = argv[++i];
+        } else if (arg == "--batch" && i + 1 < argc) {
+            net.batch = min(max(1, stoi(argv[++i])), NET_MAX_BATCH);
+        } else if (arg == "--archive" && i + 1 < argc) {
+            archive_path = argv[++i];
+        } else if (arg == "--quiet") {
+            quiet = true;
+        } else if (arg == "--history" && i + 1 < argc) {
+            history_slots = stoi(argv[++i]);
+        } else if (arg == "--dashboard" && i + 1 < argc) {
+            dashboard_sec = stoi(argv[++i]);
+        } else if (arg == "--combine" && i + 1 < argc) {
+            string v = argv[++i];
+            size_t colon = v.find(':');
+            combine_every = stoi(v.substr(0, colon));
+            if (colon != string::npos) combine_ms = stoi(v.substr(colon + 1));
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (arg == "--ring-auto") {
+            tuner.enabled = true;
+        } else if (arg == "--ring-max" && i + 1 < argc) {
+            tuner.max_size = stoi(argv[++i]);
+        } else if (arg == "--bench-sched") {
+            bench_sched = true;
+        } else if (arg == "--bench-map") {
+            bench_map = true;
+        } else if (arg == "--huge-pages") {
+            map_opts.huge = true;
+        } else if (arg == "--prefault") {
+            map_opts.prefault = true;
+        } else if (arg == "--mlock") {
+            map_opts.lock = true;
+        } else if (i == 3 && arg.rfind("--", 0) != 0) {
+            buf_size = stoi(arg);
+        } else {
+            cerr << "Неизвестный ключ: " << arg << "\n";
+            return 1;
+        }
+    }
+    pool.max_workers = num_groups;
+    if (pool.min_workers < 1) pool.min_workers = 1;
+    if (pool.min_workers > num_groups) pool.min_workers = num_groups;
+    if (!kernel_path.empty()) {
+        // путь передаётся рабочим через SHM — делаем его абсолютным, у рабочих может быть другой cwd
+        char kbuf[PATH_MAX], ibuf[PATH_MAX];
+        if (input_path.empty() || realpath(kernel_path.c_str(), kbuf) == nullptr ||
+            realpath(input_path.c_str(), ibuf) == nullptr) {
+            cerr << "--kernel требует существующие файлы ядра и --input\n";
+            return 1;
+        }
+        kernel_path = kbuf;
+        input_path = ibuf;
+        if (kernel_path.size() >= sizeof(Shared::kernel_path) || input_path.size() >= sizeof(Shared::input_path) ||
+            kernel_arg.size() >= sizeof(Shared::kernel_arg) || result_size <= 0) {
+            cerr << "Слишком длинный путь/аргумент ядра или неверный --result-size\n";
+            return 1;
+        }
+        if (daemon_mode) {
+            cerr << "--kernel не поддерживается в режиме демона\n";
+            return 1;
+        }
+        // входной файл должен содержать блок для каждого участка
+        InputHeader hdr{};
+        int in_fd = open(input_path.c_str(), O_RDONLY);
+        bool ok = in_fd != -1 && read(in_fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr) &&
+                  hdr.magic == INPUT_MAGIC && hdr.count >= (uint64_t)num_sections;
+        if (in_fd != -1) close(in_fd);
+        if (!ok) {
+            cerr << "Входной файл " << input_path << " не подходит: нужен формат worker_named make-input и не меньше "
+                 << num_sections << " участков\n";
+            return 1;
+        }
+    }
+    if (!trace_path.empty()) {
+        // рабочие могут работать из другого каталога — путь для них делаем абсолютным
+        if (trace_path[0] != '/') {
+            char cwd[PATH_MAX];
+            if (getcwd(cwd, sizeof(cwd))) trace_path = string(cwd) + "/" + trace_path;
+        }
+        if (trace_path.size() >= sizeof(Shared::trace_path)) {
+            cerr << "Слишком длинный путь --trace\n";
+            return 1;
+        }
+        // новый файл трассы: открывающая скобка массива, дальше каждый процесс дописывает своё
+        int tfd = open(trace_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (tfd == -1 || write(tfd, "[\n", 2) != 2) {
+            perror("trace file");
+            if (tfd != -1) close(tfd);
+            return 1;
+        }
+        close(tfd);
+        g_trace = true;
+        trace_thread("Сильвер");
+    }
+    if (daemon_mode && net.enabled) {
+        cerr << "--listen не поддерживается в режиме демона\n";
+        return 1;
+    }
+    if (daemon_mode && combine_every > 0) {
+        cerr << "--combine не поддерживается в режиме демона: отчёты считаются по заданиям\n";
+        return 1;
+    }
+    if (daemon_mode && tuner.enabled) {
+        cerr << "--ring-auto не поддерживается в режиме демона: размер кольца задаёт --submit\n";
+        return 1;
+    }
+    if (daemon_mode && costs.enabled) {
+        cerr << "--cost-file не поддерживается в режиме демона\n";
+        return 1;
+    }
+    if (num_groups <= 0 || (num_sections <= 0 && !daemon_mode) || buf_size <= 0) {
         cerr << "Arguments must be positive integers.\n";
         return 1;
     }
 
-    if (num_sections <= num_groups) {
+    if (num_groups > MAX_WORKER_SLOTS) {
+        // у каждого рабочего свой слот статистики (= id группы); лишние не смогли бы подключиться
+        cerr << "Число групп (" << num_groups << ") больше числа слотов рабочих (" << MAX_WORKER_SLOTS
+             << "). Слоты делят и локальные, и удалённые рабочие.\n";
+        return 1;
+    }
+
+    if (!daemon_mode && num_sections <= num_groups) {
         cerr << "По условию число участков (" << argv[2] << ") должно превышать число групп (" << argv[1] << ").\n";
         return 1;
     }
 
+    if (costs.enabled) load_costs(costs, num_sections);
+    if (bench_sched) {
+        // Бенчмарк планировщика: сравнение порядка по индексу и longest-first на оценках журнала
+        if (!costs.enabled) {
+            cerr << "--bench-sched требует --cost-file\n";
+            return 1;
+        }
+        cout << makespan_report(costs.est, num_groups);
+        return 0;
+    }
+    if (bench_map) {
+        // Бенчмарк подложки сегмента: 4K / huge, с заполнением и без
+        cout << map_bench_report(buf_size, num_sections, result_size);
+        return 0;
+    }
+
     // Обработчик SIGINT
     struct sigaction sa{};
     sa.sa_handler = sigint_handler;
@@ -214,37 +2358,58 @@ int main(int argc, char* argv[]) {
 
     string shm_name = get_shm_name();
     size_t shm_size = shmsize_for(buf_size);
+    size_t order_off = 0, results_off = 0;
+    if (costs.enabled) {
+        order_off = order_offset_for(buf_size);
+        shm_size = order_off + (size_t)num_sections * sizeof(int);
+    }
+    size_t cost_off = 0;
+    if (costs.enabled && combine_every > 0) {
+        // замеры пустых участков из сводок комбайнера, по int32 на участок
+        cost_off = (shm_size + 7) / 8 * 8;
+        shm_size = cost_off + (size_t)num_sections * sizeof(int32_t);
+    }
+    size_t section_off = 0;
+    if (!daemon_mode) {
+        // карта состояния участков: 2 бита на участок, слова по 8 байт
+        section_off = (shm_size + 7) / 8 * 8;
+        shm_size = section_off + section_words(num_sections) * sizeof(uint64_t);
+    }
+    if (!kernel_path.empty()) {
+        // область результатов выравниваем по строке кэша
+        results_off = (shm_size + 63) / 64 * 64;
+        shm_size = results_off + (size_t)num_sections * result_size;
+    }
 
-    // Создаём POSIX shared memory
-    int fd = shm_open(shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
-    if (fd == -1) {
-        perror("shm_open");
+    // Создаём POSIX shared memory (или файл на hugetlbfs при --huge-pages)
+    int map_kind = MAP_KIND_4K;
+    uint64_t t_created = mono_ns();
+    void* mem = segment_create(shm_name, shm_size, map_opts, map_kind);
+    if (mem == MAP_FAILED) {
+        perror("shm_open/mmap");
         // также отправим в observer (если возможно)
         std::ostringstream eoss;
-        eoss << "[Manager][ERROR] shm_open failed: " << strerror(errno) << "\n";
+        eoss << "[Manager][ERROR] shm_open/mmap failed: " << strerror(errno) << "\n";
         send_to_observers(eoss.str());
         return 1;
     }
-
-    if (ftruncate(fd, (off_t)shm_size) == -1) {
-        perror("ftruncate");
-        shm_unlink(shm_name.c_str());
-        std::ostringstream eoss;
-        eoss << "[Manager][ERROR] ftruncate failed: " << strerror(errno) << "\n";
-        send_to_observers(eoss.str());
-        return 1;
+    double prefault_ms = (mono_ns() - t_created) / 1e6;
+    t_created = mono_ns();
+    // горячая часть — управляющие поля и кольцо отчётов; таблицы участков не закрепляем
+    size_t hot_size = min((shmsize_for(buf_size) + 4095) / 4096 * 4096, shm_size);
+    bool locked = false;
+    if (map_opts.lock) {
+        locked = mlock(mem, hot_size) == 0;
+        if (!locked) perror("mlock (продолжаем без закрепления)");
     }
 
-    void* mem = mmap(nullptr, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (mem == MAP_FAILED) {
-        perror("mmap");
-        shm_unlink(shm_name.c_str());
-        std::ostringstream eoss;
-        eoss << "[Manager][ERROR] mmap failed: " << strerror(errno) << "\n";
-        send_to_observers(eoss.str());
+    size_t history_size = history_slots > 0 ? history_create(history_slots) : 0;
+    if (!stats_create()) {
+        perror("stats shm");
+        munmap(mem, shm_size);
+        segment_unlink(shm_name, map_kind);
         return 1;
     }
-    close(fd); // дескриптор можно закрыть, область останется доступной через mmap
 
     Shared* shared = (Shared*)mem;
     // Инициализация управл. полей
@@ -254,9 +2419,43 @@ int main(int argc, char* argv[]) {
     shared->reports_cons_idx = 0;
     shared->processed_reports = 0;
     shared->buf_size = buf_size;
+    shared->ring_gen = 0;
+    shared->slots_blocked = 0;
+    shared->combine_every = combine_every;
+    shared->combine_ms = combine_ms;
     shared->shutdown = 0;
     shared->active_workers = 0;
     shared->max_workers = num_groups;
+    shared->use_order = 0;
+    shared->order_offset = 0;
+    shared->daemon = daemon_mode ? 1 : 0;
+    strcpy(shared->kernel_path, kernel_path.c_str());
+    strcpy(shared->kernel_arg, kernel_arg.c_str());
+    strcpy(shared->input_path, input_path.c_str());
+    strcpy(shared->trace_path, trace_path.c_str());
+    shared->map_kind = map_kind;
+    shared->map_prefault = map_opts.prefault ? 1 : 0;
+    // сегмент только что создан: ftruncate обнулил карту — все участки свободны
+    shared->section_offset = section_off;
+    if (section_off) {
+        g_section_map = (uint64_t*)((char*)mem + section_off);
+        g_section_total = num_sections;
+    }
+    shared->results_offset = results_off;
+    shared->result_size = result_size;
+    shared->cost_offset = cost_off;
+    int32_t *cost_samples = cost_off ? (int32_t *)((char *)mem + cost_off) : nullptr;
+    if (cost_samples) memset(cost_samples, 0xff, (size_t)num_sections * sizeof(int32_t));   // все -1
+    shared->job_cursor = 0;
+    shared->observer_suppressed = 0;
+    memset(shared->jobs, 0, sizeof(shared->jobs));
+    if (costs.enabled) {
+        vector<int> order = lpt_order(costs.est);
+        int* shm_order = (int*)((char*)mem + order_off);
+        for (int i = 0; i < num_sections; ++i) shm_order[i] = order[i];
+        shared->order_offset = order_off;
+        shared->use_order = 1;
+    }
 
     // named semaphores
     string s_mutex = get_sem_name("_mutex");
@@ -291,10 +2490,60 @@ int main(int argc, char* argv[]) {
         if (items_mutex != SEM_FAILED) sem_close(items_mutex);
         if (slots_mutex != SEM_FAILED) sem_close(slots_mutex);
         if (workers_mutex != SEM_FAILED) sem_close(workers_mutex);
-        shm_unlink(shm_name.c_str());
+        segment_unlink(shm_name, map_kind);
         return 1;
     }
 
+    // Режим демона: семафор невыданных участков и поток приёма заданий
+    string s_work = get_sem_name("_work");
+    sem_t* work_sem = SEM_FAILED;
+    Daemon daemon;
+    pthread_t acceptor_thread{};
+    if (daemon_mode) {
+        safe_sem_unlink(s_work.c_str());
+        work_sem = sem_open(s_work.c_str(), O_CREAT | O_EXCL, 0600, 0);
+        unlink(DAEMON_SOCKET);
+        int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, DAEMON_SOCKET, sizeof(addr.sun_path) - 1);
+        if (work_sem == SEM_FAILED || lfd == -1 || bind(lfd, (sockaddr*)&addr, sizeof(addr)) == -1 ||
+            listen(lfd, 16) == -1) {
+            perror("daemon setup");
+            if (lfd != -1) close(lfd);
+            if (work_sem != SEM_FAILED) sem_close(work_sem);
+            safe_sem_unlink(s_work.c_str());
+            segment_unlink(shm_name, map_kind);
+            return 1;
+        }
+        daemon.shared = shared;
+        daemon.section_mutex = section_mutex;
+        daemon.report_mutex = report_mutex;
+        daemon.slots_mutex = slots_mutex;
+        daemon.items_mutex = items_mutex;
+        daemon.work_sem = work_sem;
+        daemon.listen_fd = lfd;
+        daemon.capacity = buf_size;
+
+        // SIGINT должен приходить в главный поток (прерывать sem_wait), а не в поток приёма
+        sigset_t block, old;
+        sigemptyset(&block);
+        sigaddset(&block, SIGINT);
+        pthread_sigmask(SIG_BLOCK, &block, &old);
+        pthread_create(&acceptor_thread, nullptr, daemon_acceptor, &daemon);
+        pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    }
+
+    pthread_t dashboard{};
+    if (dashboard_sec > 0) {
+        sigset_t block, old;
+        sigemptyset(&block);
+        sigaddset(&block, SIGINT);
+        pthread_sigmask(SIG_BLOCK, &block, &old);
+        pthread_create(&dashboard, nullptr, dashboard_thread, &dashboard_sec);
+        pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    }
+
     // Информационные сообщения — печатаем и отправляем в observer
     {
         std::ostringstream oss;
@@ -308,25 +2557,205 @@ int main(int argc, char* argv[]) {
         cout << oss.str();
         send_to_observers(oss.str());
     }
+    if (map_opts.huge || map_opts.prefault || map_opts.lock) {
+        std::ostringstream oss;
+        oss << "Сегмент: " << shm_size / 1024 << " КБ, подложка " << map_kind_name(map_kind);
+        if (map_opts.huge && map_kind == MAP_KIND_4K) oss << " (huge pages недоступны)";
+        if (map_opts.prefault) oss << ", заполнен за " << prefault_ms << " мс";
+        if (map_opts.lock) oss << (locked ? ", управляющая часть закреплена" : ", mlock не удался");
+        oss << "\n";
+        cout << oss.str();
+        send_to_observers(oss.str());
+    }
     {
         std::ostringstream oss;
         oss << "Semaphores: " << s_mutex << ", " << s_report << ", " << s_items << ", " << s_slots << ", " << s_workers << "\n";
         cout << oss.str();
         send_to_observers(oss.str());
     }
-    {
+    if (daemon_mode) {
+        std::ostringstream oss;
+        oss << "Демон: задания принимаются через " << DAEMON_SOCKET
+            << " (./manager_named --submit <num_sections>)\n";
+        cout << oss.str();
+        send_to_observers(oss.str());
+    }
+    if (pool.enabled) {
+        std::ostringstream oss;
+        oss << "Эластичный пул: рабочие " << pool.worker_path << " запускаются автоматически ("
+            << pool.min_workers << ".." << pool.max_workers << ")\n";
+        cout << oss.str();
+        send_to_observers(oss.str());
+        clock_gettime(CLOCK_MONOTONIC, &pool.last_tick);
+        for (int i = 0; i < pool.min_workers; ++i) {
+            pid_t pid = spawn_worker(pool.worker_path);
+            if (pid > 0) pool.children.push_back(pid);
+        }
+    } else {
         std::ostringstream oss;
         oss << "Ожидайте запуска рабочих в других консолях командой: ./worker_named open\n";
         cout << oss.str();
         send_to_observers(oss.str());
     }
 
+    ArchiveWriter archive;
+    if (!archive_path.empty() &&
+        !archive_open(archive, archive_path, daemon_mode ? 0 : (uint64_t)num_sections, num_sections, num_groups, 3)) {
+        cerr << "[Manager][WARN] архив " << archive_path << " недоступен, отчёты не архивируются\n";
+    }
+
+    // Планировщик: пересортировка невыданных участков не чаще раза в resort_every отчётов
+    int since_resort = 0;
+    int resort_every = max(8, num_sections / 32);
+    uint64_t run_first_ns = UINT64_MAX, run_last_ns = 0;
+
+    // Обработка одного отчёта (из кольца SHM или из сети)
+    // Учёт времени отчёта в модели стоимостей; n — сколько участков он покрывает.
+    // Замеры из сводок забираются раз в resort_every участков, перед пересортировкой.
+    auto cost_tick = [&](const Report &rep, int n) {
+        // фактический makespan: от начала самого раннего поиска до последнего отчёта
+        // (сводка — участки одного рабочего подряд, её search_ms — их сумма)
+        uint64_t now = mono_ns();
+        run_first_ns = min(run_first_ns, now - min<uint64_t>(now, (uint64_t)max(rep.search_ms, 0) * 1000000));
+        run_last_ns = now;
+        if (rep.section >= 0) update_cost(costs, rep.section, rep.search_ms);
+        since_resort += n;
+        if (since_resort < resort_every) return;
+        since_resort = 0;
+        if (cost_samples) harvest_costs(costs, cost_samples, num_sections);
+        if (costs.dirty && shared->use_order) resort_pending(costs, shared, mem, g_section_map, section_mutex);
+    };
+
+    auto process_report = [&](const Report &rep) {
+        if (rep.section < 0) {
+            // сводка комбайнера: в архив не идёт; времена её участков рабочие пишут в cost_samples
+            if (costs.enabled) cost_tick(rep, max(rep.covered, 1));
+            if (!publish_wanted(EV_REPORT, rep.group_id, false) && quiet) return;
+            std::ostringstream oss;
+            oss << "[Manager] Сводка группы " << rep.group_id << " (pid=" << rep.group_pid << "): пусто "
+                << rep.covered << " участков, поиск " << rep.search_ms << "ms\n";
+            if (!quiet) cout << oss.str();
+            publish_selected(EV_REPORT, rep.group_id, false, oss.str());
+            return;
+        }
+        archive_append(archive, rep.section, rep.group_id, rep.group_pid, rep.search_ms, rep.found);
+        if (costs.enabled) cost_tick(rep, 1);
+
+        // Фильтры наблюдателей проверяются до форматирования: если строка никому не нужна — не собираем её
+        bool to_observers = publish_wanted(EV_REPORT, rep.group_id, rep.found);
+        if (quiet && !to_observers) {
+            if (daemon_mode) daemon_on_report(daemon, rep);
+            return;
+        }
+
+        // Обработка отчёта — формируем сообщение
+        uint64_t t_fmt = trace_begin();
+        char tbuf[64];
+        struct tm tm;
+        localtime_r(&rep.t, &tm);
+        strftime(tbuf, sizeof(tbuf), "%Y-%m-%d %H:%M:%S", &tm);
+
+        std::ostringstream oss;
+        oss << "[Manager] Получен отчёт: ";
+        if (daemon_mode) oss << "задание " << rep.job_id << ", ";
+        oss << "группа " << rep.group_id
+            << " (pid=" << rep.group_pid << ") участок #" << rep.section
+            << (rep.found ? " => Сундук НАЙДЕН!" : " => пусто")
+            << "  time=" << tbuf;
+        if (rep.result_len > 0) {
+            // результат ядра читаем прямо из общей области, без копии в отчёте
+            const unsigned char* res = (const unsigned char*)mem + shared->results_offset +
+                                       (size_t)rep.section * shared->result_size;
+            char hex[3];
+            oss << "  result=";
+            for (int b = 0; b < rep.result_len && b < 16; ++b) {
+                snprintf(hex, sizeof(hex), "%02x", res[b]);
+                oss << hex;
+            }
+        }
+        oss << "\n";
+
+        // Печатаем в консоль и отправляем в observer
+        std::string msg = oss.str();
+        trace_end("format", t_fmt, "section", rep.section);
+        if (!quiet) cout << msg;
+        if (to_observers) publish_selected(EV_REPORT, rep.group_id, rep.found, msg);
+
+        if (daemon_mode) daemon_on_report(daemon, rep);
+    };
+
+    if (net.enabled) {
+        net.listen_fd = net_listen(net.addr);
+        if (net.listen_fd == -1) {
+            cerr << "Не удалось открыть " << net.addr << " для удалённых рабочих\n";
+            g_stop = 1;
+        } else {
+            std::ostringstream oss;
+            oss << "Удалённые рабочие: ./worker_named connect " << net.addr << " (пачка " << net.batch << ")\n";
+            cout << oss.str();
+            send_to_observers(oss.str());
+        }
+    }
+
+    // Кольцо отчётов начинается с поколения 0 в основном сегменте
+    ReportRing ring;
+    ring.reports = shared->reports;
+    tuner.min_size = buf_size;
+    if (!daemon_mode) {
+        struct sigaction rsa{};
+        rsa.sa_handler = ring_signal_handler;
+        sigemptyset(&rsa.sa_mask);
+        sigaction(SIGUSR1, &rsa, nullptr);
+        sigaction(SIGUSR2, &rsa, nullptr);
+    }
+
     // Сильвер — принимает отчёты
     int total_to_process = num_sections;
-    while (!g_stop && shared->processed_reports < total_to_process) {
-        // ждём появления элемента
-        if (sem_wait(items_mutex) == -1) {
-            if (errno == EINTR) {
+    long long ring_records = 0;   // записей отчётов (со сводками комбайнера их меньше, чем участков)
+    uint64_t first_report_ns = 0; // первый отчёт от создания сегмента (сравнение подложек)
+    while (!g_stop && (daemon_mode || shared->processed_reports < total_to_process)) {
+        // ждём появления элемента; в эластичном режиме, при автоподборе кольца и пока медленным
+        // наблюдателям есть что дослать — просыпаемся периодически
+        int wr;
+        uint64_t t_wait = 0;
+        if (pool.enabled) elastic_tick(pool, shared, section_mutex, report_mutex);
+        if (!daemon_mode) ring_tick(tuner, shared, ring, report_mutex, slots_mutex);
+        observers_flush();
+        if (net.enabled) {
+            // общий цикл: отчёты из кольца забираем без блокировки, а когда их нет — ждём в poll на сокетах
+            wr = sem_trywait(items_mutex);
+            bool ring_empty = wr == -1 && errno == EAGAIN;
+            int wait_errno = errno;
+            vector<Report> net_reports;
+            uint64_t t_poll = trace_begin();
+            net_poll(net, shared, mem, section_mutex, ring_empty ? 10 : 0, net_reports);
+            trace_end("net-poll", t_poll, "reports", (int64_t)net_reports.size());
+            for (const Report &r : net_reports) {
+                if (r.section >= 0) section_done(g_section_map, r.section);
+                shared->processed_reports++;
+                ring_records++;
+                if (!first_report_ns) first_report_ns = mono_ns() - t_created;
+                process_report(r);
+            }
+            if (ring_empty) continue;
+            errno = wait_errno;
+        } else if (pool.enabled || tuner.enabled || observers_pending()) {
+            timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += 200 * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            t_wait = trace_begin();
+            wr = sem_timedwait(items_mutex, &deadline);
+        } else {
+            t_wait = trace_begin();
+            wr = sem_wait(items_mutex);
+        }
+        trace_end("wait", t_wait);
+        if (wr == -1) {
+            if (errno == EINTR || errno == ETIMEDOUT) {
                 if (g_stop) break;
                 continue;
             }
@@ -337,6 +2766,7 @@ int main(int argc, char* argv[]) {
             break;
         }
 
+        uint64_t t_deq = trace_begin();
         if (sem_wait(report_mutex) == -1) {
             perror("sem_wait report_mutex");
             std::ostringstream eoss;
@@ -347,29 +2777,17 @@ int main(int argc, char* argv[]) {
         }
 
         int idx = shared->reports_cons_idx % shared->buf_size;
-        Report rep = shared->reports[idx]; // копируем наружу
+        Report rep = ring.reports[idx]; // копируем наружу
         shared->reports_cons_idx++;
-        shared->processed_reports++;
+        shared->processed_reports += max(rep.covered, 1);   // сводка комбайнера учитывает сразу много участков
+        ring_records++;
+        if (!first_report_ns) first_report_ns = mono_ns() - t_created;
 
         sem_post(report_mutex);
         sem_post(slots_mutex);
+        trace_end("dequeue", t_deq, "section", rep.section);
 
-        // Обработка отчёта — формируем сообщение
-        char tbuf[64];
-        struct tm tm;
-        localtime_r(&rep.t, &tm);
-        strftime(tbuf, sizeof(tbuf), "%Y-%m-%d %H:%M:%S", &tm);
-
-        std::ostringstream oss;
-        oss << "[Manager] Получен отчёт: группа " << rep.group_id
-            << " (pid=" << rep.group_pid << ") участок #" << rep.section
-            << (rep.found ? " => Сундук НАЙДЕН!" : " => пусто")
-            << "  time=" << tbuf << "\n";
-
-        // Печатаем в консоль и отправляем в observer
-        std::string msg = oss.str();
-        cout << msg;
-        send_to_observers(msg);
+        process_report(rep);
     }
 
     // Если прервано клавишей — оповещаем worker процессы
@@ -382,21 +2800,108 @@ int main(int argc, char* argv[]) {
         shared->shutdown = 1;
     }
 
+    if (net.enabled && net.listen_fd != -1) {
+        // отдаём DONE и закрываем соединения; удалённые рабочие завершатся по EOF
+        for (NetConn &c : net.conns) {
+            if (!c.done_sent) net_queue(c, NET_DONE, nullptr, 0);
+            send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+            close(c.fd);
+        }
+        close(net.listen_fd);
+        if (net.addr.rfind("unix:", 0) == 0) unlink(net.addr.substr(5).c_str());
+        std::ostringstream oss;
+        oss << "[Manager][net] выдано пачек: " << net.batches_sent << ", получено пачек отчётов: "
+            << net.report_batches << "\n";
+        cout << oss.str();
+        send_to_observers(oss.str());
+    }
+
+    if (daemon_mode) {
+        // рабочие демона спят на _work — будим всех, чтобы они увидели shutdown
+        shared->shutdown = 1;
+        for (int k = 0; k < shared->max_workers + (int)pool.children.size(); ++k) sem_post(work_sem);
+        shutdown(daemon.listen_fd, SHUT_RDWR);
+        close(daemon.listen_fd);
+        pthread_join(acceptor_thread, nullptr);
+        unlink(DAEMON_SOCKET);
+        for (int j = 0; j < MAX_JOBS; ++j)
+            if (daemon.jobs[j].client_fd != -1) {
+                write_all(daemon.jobs[j].client_fd, "ABORTED\n");
+                close(daemon.jobs[j].client_fd);
+            }
+    }
+
     sleep(2);
 
+    // Дожидаемся рабочих, запущенных пулом
+    if (pool.enabled) {
+        for (int tries = 0; tries < 30 && !pool.children.empty(); ++tries) {
+            reap_children(pool);
+            if (!pool.children.empty()) usleep(100000);
+        }
+        for (pid_t pid : pool.children) {
+            kill(pid, SIGTERM);
+            waitpid(pid, nullptr, 0);
+        }
+    }
+
     {
         std::ostringstream oss;
-        oss << "[Manager] обработано отчётов: " << shared->processed_reports << " из " << total_to_process << "\n";
+        if (daemon_mode)
+            oss << "[Manager] демон остановлен, обработано отчётов: " << shared->processed_reports << "\n";
+        else
+            oss << "[Manager] обработано отчётов: " << shared->processed_reports << " из " << total_to_process << "\n";
+        oss << "[Manager] сообщений отсечено фильтрами наблюдателей: Сильвер " << g_suppressed
+            << ", рабочие " << __atomic_load_n(&shared->observer_suppressed, __ATOMIC_RELAXED) << "\n";
+        if (g_section_map) {
+            long long claimed, done;
+            section_count(g_section_map, num_sections, claimed, done);
+            oss << "[Manager] карта участков: обследовано " << done << " из " << num_sections << ", взято и не закончено "
+                << claimed << "\n";
+        }
+        if ((map_opts.huge || map_opts.prefault || map_opts.lock) && first_report_ns)
+            oss << "[Manager] первый отчёт через " << first_report_ns / 1e6 << " мс после создания сегмента ("
+                << map_kind_name(map_kind) << (map_opts.prefault ? ", prefault" : "") << ")\n";
+        if (combine_every > 0)
+            oss << "[Manager] комбайнер: записей отчётов " << ring_records << " на " << shared->processed_reports
+                << " участков\n";
+        if (g_spilled || g_spill_dropped)
+            oss << "[Manager] доставка без потерь: через файл очереди прошло " << g_spilled
+                << " кадров, не поместилось " << g_spill_dropped << "\n";
         cout << oss.str();
         send_to_observers(oss.str());
     }
 
+    archive_close(archive);
+    if (dashboard_sec > 0) {
+        g_dashboard_stop = true;
+        pthread_join(dashboard, nullptr);
+    }
+
+    if (costs.enabled) {
+        if (cost_samples) harvest_costs(costs, cost_samples, num_sections);
+        // Сравнение с порядком по индексу на фактически измеренных временах этого прогона
+        vector<double> measured(costs.est);
+        for (size_t i = 0; i < measured.size(); ++i)
+            if (costs.actual[i] >= 0) measured[i] = costs.actual[i];
+        double wall_ms = run_last_ns > run_first_ns ? (run_last_ns - run_first_ns) / 1e6 : 0.0;
+        string msg = makespan_report(measured, num_groups, wall_ms);
+        msg += "[Manager][sched] пересортировок невыданных участков: " + to_string(costs.resorts) + "\n";
+        cout << msg;
+        send_to_observers(msg);
+        save_costs(costs);
+    }
+
     // Очистка: уничтожение семафоров и shared memory
     sem_close(section_mutex);
     sem_close(report_mutex);
     sem_close(items_mutex);
     sem_close(slots_mutex);
     sem_close(workers_mutex);
+    if (work_sem != SEM_FAILED) {
+        sem_close(work_sem);
+        safe_sem_unlink(s_work.c_str());
+    }
 
     // unlink именованных семафоров
     safe_sem_unlink(s_mutex.c_str());
@@ -405,8 +2910,13 @@ int main(int argc, char* argv[]) {
     safe_sem_unlink(s_slots.c_str());
     safe_sem_unlink(s_workers.c_str());
 
+    if (locked) munlock(mem, hot_size);
     munmap(mem, shm_size);
-    shm_unlink(shm_name.c_str());
+    segment_unlink(shm_name, map_kind);
+    if (ring.map_size) {
+        munmap(ring.reports, ring.map_size);
+        shm_unlink(ring_name(ring.gen).c_str());
+    }
 
     {
         std::ostringstream oss;
@@ -415,6 +2925,17 @@ int main(int argc, char* argv[]) {
         // Попытка отправить финальное сообщение (если FIFO доступен)
         send_to_observers(oss.str());
     }
+    // медленным наблюдателям без потерь — немного времени дочитать очередь
+    observers_drain(10000);
+    if (g_history) {
+        munmap(g_history, history_size);
+        g_history = nullptr;
+        shm_unlink(HISTORY_SHM);
+    }
+    munmap(g_stats, sizeof(StatsTable));
+    shm_unlink(STATS_SHM);
+    trace_dump(trace_path, "manager_named");
+    if (g_trace) cout << "[Manager] трасса: " << trace_path << " (chrome://tracing, ui.perfetto.dev)\n";
 
     return 0;
 }
@@ -5,9 +5,107 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <ctime>
+#include <sched.h>
+#include <sys/mman.h>
 
 using namespace std;
 
+// Окно истории публикаторов (см. HistoryRing в manager_named.cpp)
+constexpr int HISTORY_TEXT = 232;
+struct HistoryEntry {
+    uint64_t state;
+    uint32_t type;
+    int32_t group_id;
+    uint8_t found;
+    uint8_t pad;
+    uint16_t len;
+    char text[HISTORY_TEXT];
+};
+
+struct HistoryRing {
+    uint64_t head;
+    uint32_t slots;
+    uint32_t entry_size;
+    HistoryEntry entries[1];
+};
+
+enum EventType : unsigned { EV_INFO = 1, EV_CLAIM = 2, EV_SENT = 4, EV_REPORT = 8, EV_ALL = 15 };
+
+// Копия события seq под seqlock; false — слот уже перезаписан (или так и не дописан)
+bool history_read(const HistoryRing *h, uint64_t seq, HistoryEntry &out) {
+    const HistoryEntry &e = h->entries[seq % h->slots];
+    for (int spin = 0; spin < 1000; ++spin) {
+        uint64_t s1 = __atomic_load_n(&e.state, __ATOMIC_ACQUIRE);
+        if (s1 > 2 * seq + 2) return false;
+        if (s1 == 2 * seq + 2) {
+            memcpy(&out, (const void*)&e, sizeof(out));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&e.state, __ATOMIC_RELAXED) == s1) return true;
+        }
+        sched_yield();
+    }
+    return false;
+}
+
+// Таблица слотов рабочих (см. WorkerStats в manager_named.cpp)
+constexpr int MAX_WORKER_SLOTS = 64;
+struct alignas(64) WorkerStats {
+    int32_t pid;
+    int32_t remote;
+    uint64_t claimed;
+    uint64_t found;
+    uint64_t busy_ns;
+    uint64_t blocked_ns;
+    uint64_t heartbeat_ns;
+    uint64_t attach_ns;
+};
+
+struct StatsTable {
+    WorkerStats slots[MAX_WORKER_SLOTS];
+};
+
+static inline uint64_t mono_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Сводка по занятым слотам; читается без блокировок, значения — моментальный снимок
+string stats_dashboard(const StatsTable *tab) {
+    std::ostringstream oss;
+    char line[160];
+    uint64_t now = mono_ns();
+    // заголовок выровнен вручную: printf считает ширину в байтах, а не в символах UTF-8
+    oss << "слот  pid      вид     взято   нашёл   поиск,с    ждал,с  загр%  пульс,с\n";
+    for (int i = 0; i < MAX_WORKER_SLOTS; ++i) {
+        const WorkerStats &st = tab->slots[i];
+        int32_t pid = __atomic_load_n(&st.pid, __ATOMIC_ACQUIRE);
+        if (pid == 0) continue;
+        uint64_t busy = __atomic_load_n(&st.busy_ns, __ATOMIC_RELAXED);
+        uint64_t blocked = __atomic_load_n(&st.blocked_ns, __ATOMIC_RELAXED);
+        uint64_t attach = __atomic_load_n(&st.attach_ns, __ATOMIC_RELAXED);
+        uint64_t beat = __atomic_load_n(&st.heartbeat_ns, __ATOMIC_RELAXED);
+        double alive = now > attach ? (now - attach) / 1e9 : 0;
+        snprintf(line, sizeof(line), "%-5d %-8d %-4s %8llu %7llu %9.2f %9.2f %6.1f %8.1f\n", i, pid,
+                 __atomic_load_n(&st.remote, __ATOMIC_RELAXED) ? "сеть" : "shm",
+                 (unsigned long long)__atomic_load_n(&st.claimed, __ATOMIC_RELAXED),
+                 (unsigned long long)__atomic_load_n(&st.found, __ATOMIC_RELAXED), busy / 1e9, blocked / 1e9,
+                 alive > 0 ? 100.0 * busy / 1e9 / alive : 0.0, now > beat ? (now - beat) / 1e9 : 0.0);
+        oss << line;
+    }
+    return oss.str();
+}
+
 static volatile sig_atomic_t g_stop = 0;
 void sigint_handler(int) {
     g_stop = 1;
@@ -18,12 +116,74 @@ int main(int argc, char* argv[]) {
     cout.setf(std::ios::unitbuf);
     setvbuf(stdout, nullptr, _IONBF, 0);
 
+    // Фильтр подписки: публикаторы проверяют его до того, как формировать и писать сообщение
+    //   --types info,claim,sent,report   --found-only   --groups 1234,5678   --sample N
+    string types = "all", groups;
+    bool found_only = false;
+    long sample = 1;
+    bool use_history = true;   // при подключении посреди прогона сначала показать окно истории
+    int workers_sec = 0;       // режим сводки по рабочим: период обновления
+    bool lossless = false;     // публикаторы копят недоставленное, а не выбрасывают
+    int slow_ms = 0;           // искусственно медленное чтение (проверка режима без потерь)
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--types" && i + 1 < argc) types = argv[++i];
+        else if (arg == "--found-only") found_only = true;
+        else if (arg == "--groups" && i + 1 < argc) groups = argv[++i];
+        else if (arg == "--sample" && i + 1 < argc) sample = stol(argv[++i]);
+        else if (arg == "--no-history") use_history = false;
+        else if (arg == "--workers" && i + 1 < argc) workers_sec = stoi(argv[++i]);
+        else if (arg == "--lossless") lossless = true;
+        else if (arg == "--slow" && i + 1 < argc) slow_ms = stoi(argv[++i]);
+        else {
+            cerr << "Usage: " << argv[0] << " [--types info,claim,sent,report] [--found-only]"
+                 << " [--groups g1,g2] [--sample N] [--no-history] [--lossless [--slow ms]]\n"
+                 << "       " << argv[0] << " --workers <sec>\n";
+            return 1;
+        }
+    }
+
     signal(SIGINT, sigint_handler);
     signal(SIGTERM, sigint_handler);
 
+    // Сводка по слотам рабочих: читаем таблицу из SHM напрямую, без FIFO и без участия менеджера
+    if (workers_sec > 0) {
+        int sfd = shm_open("/treasure_demo_stats", O_RDONLY, 0);
+        if (sfd == -1) {
+            cerr << "Таблица рабочих /treasure_demo_stats не найдена — менеджер не запущен\n";
+            return 1;
+        }
+        void *p = mmap(nullptr, sizeof(StatsTable), PROT_READ, MAP_SHARED, sfd, 0);
+        close(sfd);
+        if (p == MAP_FAILED) {
+            perror("mmap stats");
+            return 1;
+        }
+        while (!g_stop) {
+            cout << "\n" << stats_dashboard((const StatsTable*)p);
+            for (int t = 0; t < workers_sec * 10 && !g_stop; ++t) usleep(100000);
+        }
+        munmap(p, sizeof(StatsTable));
+        return 0;
+    }
+
     // Уникальное имя FIFO
     pid_t pid = getpid();
     string fifo_name = "/tmp/treasure_observer_fifo_" + to_string(pid);
+    string filter_name = "/tmp/treasure_observer_filter_" + to_string(pid);
+
+    // Фильтр пишем раньше FIFO (через rename — атомарно), чтобы публикатор не увидел FIFO без фильтра
+    {
+        string tmp = filter_name + ".tmp";
+        ofstream f(tmp);
+        f << "types=" << types << "\n"
+          << "found_only=" << (found_only ? 1 : 0) << "\n"
+          << "groups=" << groups << "\n"
+          << "sample=" << (sample > 0 ? sample : 1) << "\n"
+          << "lossless=" << (lossless ? 1 : 0) << "\n";
+        f.close();
+        rename(tmp.c_str(), filter_name.c_str());
+    }
 
     // Создание FIFO
     if (mkfifo(fifo_name.c_str(), 0666) == -1) {
@@ -34,28 +194,122 @@ int main(int argc, char* argv[]) {
     }
 
     cout << "[Observer pid=" << pid << "] создан канал: " << fifo_name << endl;
+    cout << "Фильтр: types=" << types << (found_only ? ", только находки" : "")
+         << (groups.empty() ? "" : ", группы " + groups) << ", выборка 1/" << sample
+         << (lossless ? ", без потерь" : "") << "\n";
     cout << "Ожидаю сообщения...\n";
 
     int fd = open(fifo_name.c_str(), O_RDONLY | O_NONBLOCK);
     if (fd == -1) {
         perror("open fifo");
         unlink(fifo_name.c_str());
+        unlink(filter_name.c_str());
         return 1;
     }
 
+    // Тот же фильтр, что и у публикаторов, — для событий из окна истории
+    unsigned type_mask = 0;
+    vector<int> group_list;
+    {
+        string item;
+        stringstream ts(types);
+        while (getline(ts, item, ',')) {
+            if (item == "all") type_mask |= EV_ALL;
+            else if (item == "info") type_mask |= EV_INFO;
+            else if (item == "claim") type_mask |= EV_CLAIM;
+            else if (item == "sent") type_mask |= EV_SENT;
+            else if (item == "report") type_mask |= EV_REPORT;
+        }
+        stringstream gs(groups);
+        while (getline(gs, item, ','))
+            if (!item.empty()) group_list.push_back(stoi(item));
+    }
+    auto matches = [&](const HistoryEntry &e) {
+        if (!(type_mask & e.type) || (found_only && !e.found && e.type != EV_INFO)) return false;
+        return group_list.empty() || e.group_id < 0 ||
+               find(group_list.begin(), group_list.end(), e.group_id) != group_list.end();
+    };
+
+    // Окно истории открываем уже после FIFO: события с номером >= head публикатор отправит и в FIFO.
+    // Пока публикаторы могли ещё не заметить новый FIFO (до секунды), досматриваем историю сами;
+    // дубли отсекаются по номеру события из префикса "@<seq> ".
+    const HistoryRing *hist = nullptr;
+    size_t hist_size = 0;
+    uint64_t cursor = 0, replay_end = 0;
+    set<uint64_t> from_history, live_seen;   // номера, показанные из окна / пришедшие через FIFO
+    struct timespec cutover{};
+    if (use_history) {
+        int hfd = shm_open("/treasure_demo_history", O_RDONLY, 0);
+        struct stat st;
+        if (hfd != -1 && fstat(hfd, &st) == 0 && (size_t)st.st_size > offsetof(HistoryRing, entries)) {
+            void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, hfd, 0);
+            if (p != MAP_FAILED) {
+                hist = (const HistoryRing*)p;
+                hist_size = st.st_size;
+            }
+        }
+        if (hfd != -1) close(hfd);
+    }
+    if (hist) {
+        uint64_t head = __atomic_load_n(&hist->head, __ATOMIC_ACQUIRE);
+        uint64_t from = head > hist->slots ? head - hist->slots : 0;
+        cout << "--- история: события " << from << ".." << (head ? head - 1 : 0) << " ---\n";
+        HistoryEntry e;
+        for (uint64_t seq = from; seq < head; ++seq)
+            if (history_read(hist, seq, e) && matches(e)) cout << string(e.text, e.len);
+        cout << "--- дальше живые события ---\n";
+        cursor = replay_end = head;
+        clock_gettime(CLOCK_MONOTONIC, &cutover);
+        cutover.tv_sec += 2;
+    }
+
     char buf[512];
+    string pending;
     while (!g_stop) {
-        ssize_t n = read(fd, buf, sizeof(buf) - 1);
+        ssize_t n = read(fd, buf, sizeof(buf));
         if (n > 0) {
-            buf[n] = '\0';
-            std::cout << buf;
-        } else {
-            usleep(200000); // небольшая пауза
+            pending.append(buf, n);
+            size_t pos;
+            while ((pos = pending.find('\n')) != string::npos) {
+                string line = pending.substr(0, pos + 1);
+                pending.erase(0, pos + 1);
+                if (line[0] == '@') {
+                    size_t sp = line.find(' ');
+                    uint64_t seq = strtoull(line.c_str() + 1, nullptr, 10);
+                    if (sp != string::npos) line.erase(0, sp + 1);
+                    // событие уже показано из истории (все кадры одного события несут один номер)
+                    if (hist && (seq < replay_end || from_history.count(seq))) continue;
+                    if (hist) live_seen.insert(seq);
+                }
+                std::cout << line;
+                if (slow_ms > 0) usleep(slow_ms * 1000);
+            }
+        }
+
+        if (hist) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (now.tv_sec < cutover.tv_sec || (now.tv_sec == cutover.tv_sec && now.tv_nsec < cutover.tv_nsec)) {
+                // переходный период: берём из истории то, что не пришло через FIFO
+                uint64_t head = __atomic_load_n(&hist->head, __ATOMIC_ACQUIRE);
+                HistoryEntry e;
+                for (; cursor < head; ++cursor)
+                    if (!live_seen.count(cursor) && history_read(hist, cursor, e)) {
+                        from_history.insert(cursor);
+                        if (matches(e)) cout << string(e.text, e.len);
+                    }
+            }
+            // номера старше окна уже не придут повторно
+            while (from_history.size() > 4 * (size_t)hist->slots) from_history.erase(from_history.begin());
+            while (live_seen.size() > 4 * (size_t)hist->slots) live_seen.erase(live_seen.begin());
         }
+        if (n <= 0) usleep(hist ? 20000 : 200000); // небольшая пауза
     }
 
     cout << "\n[Observer pid=" << pid << "] Завершаюсь...\n";
     close(fd);
+    if (hist) munmap((void*)hist, hist_size);
     unlink(fifo_name.c_str());
+    unlink(filter_name.c_str());
     return 0;
 }
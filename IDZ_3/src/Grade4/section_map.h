@@ -0,0 +1,67 @@
+#pragma once
+
+// ---------------- Карта состояния участков ----------------
+// 2 бита на участок, 32 участка в 64-битном слове: миллиард участков занимает 250 МБ
+// вместо 4 ГБ у массива int. 00 — свободен, 01 — взят, 10 — обследован.
+// Состояние меняется только вперёд, поэтому курсор next_section монотонен: левее него
+// свободных участков нет.
+// У manager_named и worker_named карта лежит в SHM (section_offset), у IDZ_4 treasure — в куче.
+
+#include <cstddef>
+#include <cstdint>
+
+constexpr uint64_t SECTION_LO = 0x5555555555555555ull;   // младшие биты пар
+constexpr uint64_t SECTION_HI = 0xAAAAAAAAAAAAAAAAull;   // старшие биты пар
+
+inline size_t section_words(int n) { return ((size_t)n + 31) / 32; }
+
+// Захват первого свободного участка не левее *hint: поиск по словам, CAS на слово.
+// -1 — свободных участков не осталось.
+inline int section_claim(uint64_t *map, int n, int *hint) {
+    size_t words = section_words(n);
+    for (size_t i = (size_t)__atomic_load_n(hint, __ATOMIC_RELAXED) / 32; i < words; ++i) {
+        uint64_t w = __atomic_load_n(&map[i], __ATOMIC_ACQUIRE);
+        for (;;) {
+            uint64_t free = ~(w | (w >> 1)) & SECTION_LO;
+            if (i == words - 1 && n % 32) free &= (1ull << (2 * (n % 32))) - 1;   // пары за концом карты
+            if (!free) break;
+            int bit = __builtin_ctzll(free);
+            if (__atomic_compare_exchange_n(&map[i], &w, w | (1ull << bit), true, __ATOMIC_ACQ_REL,
+                                            __ATOMIC_ACQUIRE)) {
+                int s = (int)(i * 32 + bit / 2);
+                int h = __atomic_load_n(hint, __ATOMIC_RELAXED);
+                while (h < s + 1 &&
+                       !__atomic_compare_exchange_n(hint, &h, s + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                }
+                return s;
+            }
+        }
+    }
+    return -1;
+}
+
+// Отметка участка, выданного по таблице порядка (планировщик): свободен -> взят
+inline void section_take(uint64_t *map, int s) {
+    __atomic_fetch_or(&map[s / 32], 1ull << (2 * (s % 32)), __ATOMIC_ACQ_REL);
+}
+
+// -> обследован; повторная отметка ничего не меняет
+inline void section_done(uint64_t *map, int s) {
+    uint64_t *w = &map[s / 32];
+    int shift = 2 * (s % 32);
+    uint64_t cur = __atomic_load_n(w, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(w, &cur, (cur & ~(3ull << shift)) | (2ull << shift), true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+}
+
+// Прогресс по карте через popcount: взятые сейчас и обследованные
+inline void section_count(const uint64_t *map, int n, long long &claimed, long long &done) {
+    claimed = done = 0;
+    size_t words = section_words(n);
+    for (size_t i = 0; i < words; ++i) {
+        uint64_t w = __atomic_load_n(&map[i], __ATOMIC_RELAXED);
+        claimed += __builtin_popcountll(w & SECTION_LO);
+        done += __builtin_popcountll(w & SECTION_HI);
+    }
+}
@@ -14,6 +14,24 @@
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <dirent.h>
+#include <dlfcn.h>      // dlopen, dlsym
+#include <pthread.h>
+#include <cstdint>
+#include <cstddef>
+#include <climits>
+#include <map>
+#include <deque>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <sys/syscall.h>  // SYS_gettid для трассы
+
+#include "section_map.h"
 
 using namespace std;
 
@@ -22,12 +40,44 @@ void sigint_handler(int) {
     g_terminate = 1;
 }
 
+// SIGUSR1 — менеджер отзывает рабочего из эластичного пула:
+// текущий участок дорабатывается и сдаётся, новый не берётся
+static volatile sig_atomic_t g_retire = 0;
+void sigusr1_handler(int) {
+    g_retire = 1;
+}
+
 struct Report {
     pid_t group_pid;
     int group_id;
     int section;
     bool found;
     time_t t;
+    int search_ms;     // фактическая длительность поиска
+    int job_id;        // задание демона (0 — обычный запуск)
+    int result_len;    // байт результата ядра в области результатов (участок * result_size)
+    int covered;       // сколько участков учитывает запись: 1 или число пустых в сводке комбайнера
+};
+
+// Входной файл ядра: заголовок, таблица смещений (count + 1 штук, от начала данных)
+// и блоки участков подряд. Рабочие отображают его только на чтение и передают
+// ядру указатель прямо в отображение, без копирования.
+constexpr uint64_t INPUT_MAGIC = 0x31544e4953525454ULL; // "TTRSINT1"
+struct InputHeader {
+    uint64_t magic;
+    uint64_t count;
+};
+
+// Задания режима демона. Участки задания — [0, total), next — следующий к выдаче.
+constexpr int MAX_JOBS = 8;
+struct JobSlot {
+    int id;
+    int active;
+    int total;
+    int next;
+    int work_min_ms;   // профиль работы: время поиска участка
+    int work_max_ms;
+    int found_pct;     // вероятность найти сундук, %
 };
 
 struct Shared {
@@ -40,17 +90,286 @@ struct Shared {
     int shutdown;
     int active_workers;
     int max_workers;
+    // режим демона: участки выдаются из таблицы заданий по кругу
+    int daemon;
+    int job_cursor;
+    JobSlot jobs[MAX_JOBS];
+    // сообщений, отсечённых фильтрами наблюдателей (рабочие добавляют при выходе)
+    unsigned long long observer_suppressed;
+    // порядок выдачи участков (планировщик по стоимости): order[next_section]
+    int use_order;
+    size_t order_offset;
+    // подключаемое ядро (dlopen) и общий входной файл; пустой путь — имитация sleep
+    char kernel_path[256];
+    char kernel_arg[64];
+    char input_path[256];
+    size_t results_offset;   // область результатов ядра: result_size байт на участок
+    int result_size;
+    // поколение кольца отчётов: 0 — массив reports ниже, N > 0 — сегмент /treasure_demo_ring_N
+    int ring_gen;
+    unsigned long long slots_blocked;
+    // комбайнер рабочих: сводка пустых участков раз в combine_every штук или combine_ms мс; 0 — выключен
+    int combine_every;
+    int combine_ms;
+    // файл трассы (--trace), рабочие дописывают в него свои интервалы; пустой — трасса выключена
+    char trace_path[256];
+    // подложка сегмента (MapKind) и --prefault: рабочие повторяют madvise и заполнение у себя
+    int map_kind;
+    int map_prefault;
+    // карта состояния участков (2 бита на участок), 0 — нет (режим демона)
+    size_t section_offset;
+    // замеры пустых участков, ушедших в сводку комбайнера: int32 мс на участок, -1 — ещё не забран
+    // менеджером; 0 — нет (без --cost-file или без --combine)
+    size_t cost_offset;
     Report reports[1];
 };
 
+// Таблица слотов рабочих: отдельный сегмент /treasure_demo_stats (создаёт менеджер).
+// Номер слота — плотный id группы 0..MAX_WORKER_SLOTS-1; слот занимается при подключении и
+// освобождается при выходе. Статистику слота пишет только его владелец (обычными store,
+// без RMW), поэтому менеджер и observer читают её без блокировок. Блок — ровно строка кэша.
+constexpr int MAX_WORKER_SLOTS = 64;
+struct alignas(64) WorkerStats {
+    int32_t pid;             // 0 — слот свободен
+    int32_t remote;          // 1 — удалённый рабочий, слот ведёт менеджер
+    uint64_t claimed;        // взято участков
+    uint64_t found;          // найдено сундуков
+    uint64_t busy_ns;        // время поиска
+    uint64_t blocked_ns;     // ожидание семафоров (участки, место в кольце, запись отчёта)
+    uint64_t heartbeat_ns;   // CLOCK_MONOTONIC последнего обновления
+    uint64_t attach_ns;
+};
+static_assert(sizeof(WorkerStats) == 64, "WorkerStats must fill one cache line");
+
+struct StatsTable {
+    WorkerStats slots[MAX_WORKER_SLOTS];
+};
+
+static const char *STATS_SHM = "/treasure_demo_stats";
+
+static inline uint64_t mono_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Единственный писатель: атомарный store, чтобы читатель не увидел разорванное значение
+static inline void stat_add(uint64_t &field, uint64_t v) {
+    __atomic_store_n(&field, field + v, __ATOMIC_RELAXED);
+}
+
+static inline void stat_touch(WorkerStats *st) {
+    __atomic_store_n(&st->heartbeat_ns, mono_ns(), __ATOMIC_RELAXED);
+}
+
+static void stat_reset(WorkerStats *st, int remote) {
+    __atomic_store_n(&st->remote, remote, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->claimed, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->found, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->busy_ns, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->blocked_ns, 0, __ATOMIC_RELAXED);
+    uint64_t now = mono_ns();
+    __atomic_store_n(&st->attach_ns, now, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->heartbeat_ns, now, __ATOMIC_RELAXED);
+}
+
+// Занимает наименьший свободный слот (CAS по pid). Слоты упавших локальных рабочих
+// (pid уже не существует) забираются повторно. -1 — свободных слотов нет.
+int stats_attach(StatsTable *tab, pid_t pid, int remote) {
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < MAX_WORKER_SLOTS; ++i) {
+            WorkerStats *st = &tab->slots[i];
+            int32_t cur = __atomic_load_n(&st->pid, __ATOMIC_ACQUIRE);
+            if (pass == 0 ? cur != 0
+                          : cur == 0 || st->remote || !(kill(cur, 0) == -1 && errno == ESRCH))
+                continue;
+            if (__atomic_compare_exchange_n(&st->pid, &cur, (int32_t)pid, false, __ATOMIC_ACQ_REL,
+                                            __ATOMIC_RELAXED)) {
+                stat_reset(st, remote);
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+void stats_detach(StatsTable *tab, int slot) {
+    if (!tab || slot < 0) return;
+    __atomic_store_n(&tab->slots[slot].pid, 0, __ATOMIC_RELEASE);
+}
+
+StatsTable* stats_open() {
+    int fd = shm_open(STATS_SHM, O_RDWR, 0);
+    if (fd == -1) return nullptr;
+    void *p = mmap(nullptr, sizeof(StatsTable), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return p == MAP_FAILED ? nullptr : (StatsTable*)p;
+}
+
+// Трассировка (--trace у менеджера). Интервалы (claim, search, wait-slot, enqueue, wait,
+// dequeue, format, fanout) копятся в буфере своего потока без блокировок; при выходе процесс
+// дописывает их в общий файл в формате Chrome trace-event (chrome://tracing, Perfetto).
+// Время — CLOCK_MONOTONIC, общий для всех процессов машины: менеджер и рабочие на одной оси.
+constexpr size_t TRACE_MAX_SPANS = 1 << 20;   // на поток; сверх этого интервалы только считаются
+struct TraceSpan {
+    const char *name;
+    uint64_t t0_ns;
+    uint64_t dur_ns;
+    const char *arg_name;   // nullptr — без аргумента
+    int64_t arg;
+};
+
+struct TraceBuffer {
+    pid_t tid;
+    string thread_name;
+    vector<TraceSpan> spans;
+    uint64_t dropped = 0;
+};
+
+static bool g_trace = false;
+static pthread_mutex_t g_trace_lock = PTHREAD_MUTEX_INITIALIZER;   // только список буферов
+static vector<TraceBuffer*> g_trace_buffers;
+static thread_local TraceBuffer *t_trace = nullptr;
+
+static TraceBuffer *trace_buffer() {
+    if (!t_trace) {
+        t_trace = new TraceBuffer();
+        t_trace->tid = (pid_t)syscall(SYS_gettid);
+        t_trace->spans.reserve(4096);
+        pthread_mutex_lock(&g_trace_lock);
+        g_trace_buffers.push_back(t_trace);
+        pthread_mutex_unlock(&g_trace_lock);
+    }
+    return t_trace;
+}
+
+// Подпись потока в трассе
+void trace_thread(const string &name) {
+    if (g_trace) trace_buffer()->thread_name = name;
+}
+
+static inline uint64_t trace_begin() { return g_trace ? mono_ns() : 0; }
+
+void trace_end(const char *name, uint64_t t0, const char *arg_name = nullptr, int64_t arg = 0) {
+    if (!g_trace || t0 == 0) return;
+    uint64_t now = mono_ns();
+    TraceBuffer *b = trace_buffer();
+    if (b->spans.size() >= TRACE_MAX_SPANS) {
+        b->dropped++;
+        return;
+    }
+    b->spans.push_back({name, t0, now - t0, arg_name, arg});
+}
+
+// Файл трассы — JSON-массив событий без закрывающей скобки (формат это допускает), поэтому
+// процессы просто дописывают свои события. Запись одна, с O_APPEND: куски разных процессов
+// не перемешиваются. Вызывать, когда остальные потоки процесса уже не пишут интервалы.
+void trace_dump(const string &path, const string &process) {
+    if (!g_trace) return;
+    string out;
+    char line[512];
+    pid_t pid = getpid();
+    uint64_t dropped = 0;
+    snprintf(line, sizeof(line),
+             "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n", (int)pid,
+             (int)pid, process.c_str());
+    out += line;
+    pthread_mutex_lock(&g_trace_lock);
+    for (TraceBuffer *b : g_trace_buffers) {
+        if (!b->thread_name.empty()) {
+            snprintf(line, sizeof(line),
+                     "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+                     (int)pid, (int)b->tid, b->thread_name.c_str());
+            out += line;
+        }
+        for (const TraceSpan &s : b->spans) {
+            int n = snprintf(line, sizeof(line),
+                             "{\"ph\":\"X\",\"cat\":\"treasure\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                             s.name, (int)pid, (int)b->tid, s.t0_ns / 1e3, s.dur_ns / 1e3);
+            if (s.arg_name)
+                snprintf(line + n, sizeof(line) - n, ",\"args\":{\"%s\":%lld}},\n", s.arg_name, (long long)s.arg);
+            else
+                snprintf(line + n, sizeof(line) - n, "},\n");
+            out += line;
+        }
+        dropped += b->dropped;
+    }
+    pthread_mutex_unlock(&g_trace_lock);
+
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd == -1) {
+        perror("open trace");
+        return;
+    }
+    const char *data = out.data();
+    size_t left = out.size();
+    while (left > 0) {
+        ssize_t w = write(fd, data, left);
+        if (w == -1 && errno == EINTR) continue;
+        if (w <= 0) {
+            perror("write trace");
+            break;
+        }
+        data += w;
+        left -= (size_t)w;
+    }
+    close(fd);
+    if (dropped)
+        cerr << "[trace] " << process << ": буфер потока переполнен, не записано интервалов: " << dropped << "\n";
+}
+
+// Подложка сегмента (см. segment_create в manager_named.cpp): при --huge-pages сегмент может
+// лежать на hugetlbfs, а не в /dev/shm; THP и заполнение страниц рабочий повторяет для своего отображения
+enum MapKind { MAP_KIND_4K = 0, MAP_KIND_THP = 1, MAP_KIND_HUGETLB = 2 };
+static const char *HUGETLB_DIR = "/dev/hugepages";
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23   // Linux 5.14+
+#endif
+
+void prefault_range(void *p, size_t size) {
+    if (madvise(p, size, MADV_POPULATE_WRITE) == 0) return;
+    volatile const char *c = (volatile const char*)p;
+    for (size_t off = 0; off < size; off += 4096) (void)c[off];
+}
+
+// Заполняется только горячая часть (управляющие поля и кольцо), см. segment_advise у менеджера
+void segment_advise(void *p, size_t size, int kind, bool prefault, size_t hot) {
+    if (kind == MAP_KIND_THP) madvise(p, size, MADV_HUGEPAGE);
+    if (prefault) prefault_range(p, min(hot, size));
+}
+
 string base_name = "/treasure_demo";
 
 string get_shm_name() { return base_name + "_shm"; }
 string get_shm_name(const string &sfx) { return base_name + sfx; }
 
+// Текущее поколение кольца отчётов (см. ring_resize в manager_named.cpp)
+struct ReportRing {
+    Report* reports = nullptr;
+    size_t map_size = 0;
+    int gen = 0;
+};
+
+// Вызывать под report_mutex: менеджер сменил поколение — отображаем новое кольцо
+bool ring_sync(ReportRing& ring, Shared* shared) {
+    int gen = __atomic_load_n(&shared->ring_gen, __ATOMIC_ACQUIRE);
+    if(gen == ring.gen) return true;
+    int fd = shm_open(get_shm_name("_ring_" + to_string(gen)).c_str(), O_RDWR, 0);
+    if(fd == -1) return false;
+    struct stat st;
+    void* p = MAP_FAILED;
+    if(fstat(fd, &st) == 0) p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) return false;
+    if(ring.map_size) munmap(ring.reports, ring.map_size);
+    ring.reports = (Report*)p;
+    ring.map_size = st.st_size;
+    ring.gen = gen;
+    return true;
+}
+
 // FIFO / observer helpers
 // const char *FIFO_PATH = "/tmp/treasure_fifo";
-static int fifo_fd = -1;
 
 // Игнорируем SIGPIPE, чтобы write() возвращал -1 с errno = EPIPE
 void init_fifo_signal_handling() {
@@ -84,79 +403,802 @@ int open_fifo_nonblocking(const std::string& path) {
     return fd;
 }
 
-void send_to_observer(const std::string& msg, const std::string& path) {
+// Подписки наблюдателей. observer при запуске кладёт рядом со своим FIFO файл фильтра
+// /tmp/treasure_observer_filter_<pid> (types=, found_only=, groups=, sample=).
+// Публикатор проверяет фильтры ДО форматирования сообщения и записи в FIFO;
+// список подписчиков перечитывается только при изменении каталога /tmp,
+// дескрипторы FIFO держатся открытыми между сообщениями.
+enum EventType : unsigned {
+    EV_INFO = 1,      // служебные сообщения: запуск, завершение, ошибки, пул, сеть
+    EV_CLAIM = 2,     // рабочий взял участок
+    EV_SENT = 4,      // рабочий отправил отчёт
+    EV_REPORT = 8,    // Сильвер обработал отчёт
+    EV_ALL = 15
+};
+
+struct ObserverSub {
+    string fifo;
+    int fd = -1;
+    unsigned types = EV_ALL;
+    bool found_only = false;
+    vector<int> groups;          // пусто — все группы
+    unsigned long sample = 1;    // доставлять каждое sample-е подходящее событие
+    unsigned long matched = 0;
+    bool selected = false;       // выбран последним observers_select
+    bool lossless = false;       // не терять сообщения: при полном канале — в очередь
+};
+
+static vector<ObserverSub> g_subs;
+static struct timespec g_subs_mtime{};
+static struct timespec g_subs_scanned{};
+static bool g_subs_loaded = false;
+static unsigned long long g_suppressed = 0;   // сообщений, отсечённых фильтрами (в этом процессе)
+
+unsigned parse_event_types(const string &list) {
+    unsigned mask = 0;
+    std::stringstream ss(list);
+    string t;
+    while (getline(ss, t, ',')) {
+        if (t == "info") mask |= EV_INFO;
+        else if (t == "claim") mask |= EV_CLAIM;
+        else if (t == "sent") mask |= EV_SENT;
+        else if (t == "report") mask |= EV_REPORT;
+        else if (t == "all") mask |= EV_ALL;
+    }
+    return mask ? mask : (unsigned)EV_ALL;
+}
+
+void load_filter(ObserverSub &sub, const string &path) {
+    std::ifstream in(path);
+    string line;
+    while (getline(in, line)) {
+        size_t eq = line.find('=');
+        if (eq == string::npos) continue;
+        string key = line.substr(0, eq), val = line.substr(eq + 1);
+        if (key == "types") sub.types = parse_event_types(val);
+        else if (key == "found_only") sub.found_only = val == "1";
+        else if (key == "sample") sub.sample = max(1L, atol(val.c_str()));
+        else if (key == "lossless") sub.lossless = val == "1";
+        else if (key == "groups") {
+            std::stringstream ss(val);
+            string g;
+            while (getline(ss, g, ',')) if (!g.empty()) sub.groups.push_back(atoi(g.c_str()));
+        }
+    }
+}
+
+// Кадры для FIFO: каждая запись — целые строки общим размером не больше PIPE_BUF вместе с
+// префиксом номера события. write() такого размера в канал атомарен, поэтому записи разных
+// публикаторов не перемешиваются, а неблокирующая запись либо проходит целиком, либо EAGAIN.
+vector<string> frame_message(const std::string &msg, uint64_t seq) {
+    string prefix = seq ? "@" + to_string(seq - 1) + " " : "";
+    size_t room = PIPE_BUF - prefix.size() - 1;
+    vector<string> frames;
+    size_t pos = 0;
+    while (pos < msg.size()) {
+        size_t len = min(msg.size() - pos, room);
+        if (pos + len < msg.size()) {
+            size_t nl = msg.rfind('\n', pos + len - 1);
+            if (nl != string::npos && nl >= pos) len = nl - pos + 1;
+        }
+        string frame = prefix + msg.substr(pos, len);
+        if (frame.back() != '\n') frame += '\n';   // строка длиннее PIPE_BUF режется на части
+        frames.push_back(frame);
+        pos += len;
+    }
+    return frames;
+}
+
+// 0 — кадр записан целиком, иначе errno (EAGAIN — канал полон)
+int write_frame(int fd, const char *data, size_t len) {
+    ssize_t w;
+    do {
+        w = write(fd, data, len);
+    } while (w == -1 && errno == EINTR);
+    if (w == (ssize_t)len) return 0;
+    return w == -1 ? errno : EIO;
+}
+
+// Очередь недоставленных кадров наблюдателя в режиме без потерь (lossless=1 в фильтре).
+// Первые QUEUE_MEM_LIMIT байт держим в памяти, дальше — в отображённом файле (он сразу
+// удаляется из /tmp, поэтому после падения мусора не остаётся). Порядок: память, затем файл.
+constexpr size_t QUEUE_MEM_LIMIT = 64 * 1024;
+constexpr size_t SPILL_LIMIT = (size_t)256 << 20;
+struct ObserverQueue {
+    std::deque<string> mem;
+    size_t mem_bytes = 0;
+    int spill_fd = -1;
+    char *spill = nullptr;
+    size_t spill_cap = 0, spill_head = 0, spill_tail = 0;   // кадры [head, tail): uint32 длина + байты
+};
+
+static std::map<string, ObserverQueue> g_queues;
+static unsigned long long g_spilled = 0;       // кадров, прошедших через файл
+static unsigned long long g_spill_dropped = 0; // кадров, не поместившихся даже в файл
+
+bool queue_empty(const ObserverQueue &q) {
+    return q.mem.empty() && q.spill_head == q.spill_tail;
+}
+
+void queue_reset(ObserverQueue &q) {
+    if (q.spill) munmap(q.spill, q.spill_cap);
+    if (q.spill_fd != -1) close(q.spill_fd);
+    q = ObserverQueue();
+}
+
+bool spill_push(ObserverQueue &q, const string &frame) {
+    size_t need = sizeof(uint32_t) + frame.size();
+    if (q.spill_tail + need > q.spill_cap) {
+        if (q.spill_head > 0) {
+            // уже доставленное начало файла освобождаем сдвигом
+            memmove(q.spill, q.spill + q.spill_head, q.spill_tail - q.spill_head);
+            q.spill_tail -= q.spill_head;
+            q.spill_head = 0;
+        }
+        if (q.spill_tail + need > q.spill_cap) {
+            size_t cap = max(q.spill_cap * 2, (size_t)1 << 20);
+            while (cap < q.spill_tail + need) cap *= 2;
+            if (cap > SPILL_LIMIT) return false;
+            if (q.spill_fd == -1) {
+                char path[64];
+                snprintf(path, sizeof(path), "/tmp/treasure_spill_%d_XXXXXX", (int)getpid());
+                q.spill_fd = mkstemp(path);
+                if (q.spill_fd == -1) return false;
+                unlink(path);
+            }
+            if (ftruncate(q.spill_fd, (off_t)cap) == -1) return false;
+            void *p = mmap(nullptr, cap, PROT_READ | PROT_WRITE, MAP_SHARED, q.spill_fd, 0);
+            if (p == MAP_FAILED) return false;
+            if (q.spill) munmap(q.spill, q.spill_cap);
+            q.spill = (char*)p;
+            q.spill_cap = cap;
+        }
+    }
+    uint32_t len = (uint32_t)frame.size();
+    memcpy(q.spill + q.spill_tail, &len, sizeof(len));
+    memcpy(q.spill + q.spill_tail + sizeof(len), frame.data(), len);
+    q.spill_tail += need;
+    g_spilled++;
+    return true;
+}
+
+void queue_push(ObserverQueue &q, const string &frame) {
+    if (q.spill_head == q.spill_tail && q.mem_bytes + frame.size() <= QUEUE_MEM_LIMIT) {
+        q.mem.push_back(frame);
+        q.mem_bytes += frame.size();
+    } else if (!spill_push(q, frame)) {
+        g_spill_dropped++;
+    }
+}
+
+// Досылает очередь, пока канал принимает. 0 — канал полон или очередь пуста, иначе errno.
+int queue_flush(int fd, ObserverQueue &q) {
+    while (!q.mem.empty()) {
+        int err = write_frame(fd, q.mem.front().data(), q.mem.front().size());
+        if (err) return err == EAGAIN ? 0 : err;
+        q.mem_bytes -= q.mem.front().size();
+        q.mem.pop_front();
+    }
+    while (q.spill_head < q.spill_tail) {
+        uint32_t len;
+        memcpy(&len, q.spill + q.spill_head, sizeof(len));
+        int err = write_frame(fd, q.spill + q.spill_head + sizeof(len), len);
+        if (err) return err == EAGAIN ? 0 : err;
+        q.spill_head += sizeof(len) + len;
+    }
+    q.spill_head = q.spill_tail = 0;
+    return 0;
+}
+
+// Перечитываем подписчиков, если в /tmp что-то создавали/удаляли, и не реже раза в секунду:
+// грубые часы mtime могут не различить создание файла фильтра и FIFO
+void refresh_subscribers() {
+    struct stat st;
+    if (stat("/tmp", &st) == -1) return;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (g_subs_loaded && st.st_mtim.tv_sec == g_subs_mtime.tv_sec && st.st_mtim.tv_nsec == g_subs_mtime.tv_nsec &&
+        now.tv_sec - g_subs_scanned.tv_sec < 1)
+        return;
+    g_subs_mtime = st.st_mtim;
+    g_subs_scanned = now;
+    g_subs_loaded = true;
+
+    vector<ObserverSub> fresh;
+    DIR *dp = opendir("/tmp");
+    if (!dp) return;
+    struct dirent *ent;
+    while ((ent = readdir(dp)) != nullptr) {
+        string name = ent->d_name;
+        if (name.find("treasure_observer_fifo_") != 0) continue;
+        ObserverSub sub;
+        sub.fifo = "/tmp/" + name;
+        string pid = name.substr(strlen("treasure_observer_fifo_"));
+        load_filter(sub, "/tmp/treasure_observer_filter_" + pid);
+        // сохраняем открытый дескриптор и счётчик выборки уже известного подписчика
+        for (ObserverSub &old : g_subs)
+            if (old.fifo == sub.fifo) {
+                sub.fd = old.fd;
+                sub.matched = old.matched;
+                old.fd = -1;
+            }
+        fresh.push_back(sub);
+    }
+    closedir(dp);
+    for (ObserverSub &old : g_subs) {
+        if (old.fd != -1) close(old.fd);
+        bool alive = false;
+        for (const ObserverSub &sub : fresh) alive = alive || sub.fifo == old.fifo;
+        auto it = g_queues.find(old.fifo);
+        if (!alive && it != g_queues.end()) {
+            // наблюдатель исчез — недоставленное ему уже не нужно
+            queue_reset(it->second);
+            g_queues.erase(it);
+        }
+    }
+    g_subs.swap(fresh);
+}
+
+// Отбирает подписчиков, которым нужно событие. false — никому: сообщение можно не формировать.
+bool observers_select(unsigned type, int group_id, bool found) {
+    refresh_subscribers();
+    bool any = false;
+    for (ObserverSub &sub : g_subs) {
+        bool ok = (sub.types & type) && (!sub.found_only || found || type == EV_INFO);
+        if (ok && !sub.groups.empty() && group_id >= 0)
+            ok = find(sub.groups.begin(), sub.groups.end(), group_id) != sub.groups.end();
+        if (ok) ok = (sub.matched++ % sub.sample) == 0;
+        sub.selected = ok;
+        if (ok) any = true;
+        else g_suppressed++;
+    }
+    return any;
+}
+
+// Канал наблюдателя закрыт — забываем дескриптор и очередь
+void observer_broken(ObserverSub &sub, int err) {
+    if (err != EPIPE) std::cerr << "[ERROR] write to FIFO failed: " << strerror(err) << "\n";
+    close(sub.fd);
+    sub.fd = -1;
+    auto it = g_queues.find(sub.fifo);
+    if (it != g_queues.end()) {
+        queue_reset(it->second);
+        g_queues.erase(it);
+    }
+}
+
+void send_to_observer(const std::string& msg, ObserverSub &sub, uint64_t seq) {
     // Если FIFO дескриптор не открыт, попробуем открыть
-    int fifo_fd = open_fifo_nonblocking(path);
-    if (fifo_fd == -1) {
+    if (sub.fd == -1) sub.fd = open_fifo_nonblocking(sub.fifo);
+    if (sub.fd == -1) {
         // Нет доступного FIFO/читателя — логируем в stderr (и остаёмся работать)
-        std::cerr << "[Manager][WARN] FIFO not available for observer; message not sent: "
+        std::cerr << "[WARN] FIFO not available for observer; message not sent: "
                     << (msg.size() > 200 ? msg.substr(0,200) + "..." : msg) ;
         // ensure newline
         if (msg.empty() || msg.back() != '\n') std::cerr << "\n";
         return;
     }
 
-    // Пишем весь буфер (учтём возможные частичные записи)
-    const char* data = msg.c_str();
-    size_t remaining = msg.size();
-    while (remaining > 0) {
-        ssize_t w = write(fifo_fd, data, remaining);
-        if (w > 0) {
-            data += w;
-            remaining -= (size_t)w;
-            continue;
+    for (const string &frame : frame_message(msg, seq)) {
+        if (sub.lossless) {
+            // сначала досылаем накопленное, чтобы не нарушить порядок
+            ObserverQueue &q = g_queues[sub.fifo];
+            int err = queue_empty(q) ? 0 : queue_flush(sub.fd, q);
+            if (err) {
+                observer_broken(sub, err);
+                return;
+            }
+            if (!queue_empty(q)) {
+                queue_push(q, frame);
+                continue;
+            }
         }
-        // w <= 0 => ошибка
-        if (w == -1) {
-            if (errno == EINTR) {
-                // прервано сигналом — попробуем снова
+        int err = write_frame(sub.fd, frame.data(), frame.size());
+        if (err == 0) continue;
+        if (err == EAGAIN || err == EWOULDBLOCK) {
+            if (sub.lossless) {
+                queue_push(g_queues[sub.fifo], frame);
                 continue;
-            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // FIFO временно недоступен (буфер полон) — не блокируем manager, логируем и отбрасываем сообщение
-                std::cerr << "[Manager][WARN] FIFO write would block, message dropped: "
-                          << (msg.size() > 200 ? msg.substr(0,200) + "..." : msg);
-                if (msg.empty() || msg.back() != '\n') std::cerr << "\n";
-                return;
-            } else if (errno == EPIPE) {
-                // Читатель закрыл канал — закроем дескриптор и пометим как недоступный
-                std::cerr << "[Manager][WARN] FIFO broken (EPIPE). Closing fifo_fd and will retry later.\n";
-                close(fifo_fd);
-                fifo_fd = -1;
-                return;
-            } else {
-                // Прочие ошибки — логируем и закрываем дескриптор
-                std::cerr << "[Manager][ERROR] write to FIFO failed: " << strerror(errno) << "\n";
-                close(fifo_fd);
-                fifo_fd = -1;
-                return;
             }
-        } else {
-            // w == 0 — возможно некорректная ситуация, закроем и выйдем
-            std::cerr << "[Manager][WARN] write returned 0, closing fifo_fd\n";
-            close(fifo_fd);
-            fifo_fd = -1;
+            // FIFO временно недоступен (буфер полон) — не блокируемся, логируем и отбрасываем сообщение
+            std::cerr << "[WARN] FIFO write would block, message dropped: "
+                      << (msg.size() > 200 ? msg.substr(0,200) + "..." : msg);
+            if (msg.empty() || msg.back() != '\n') std::cerr << "\n";
             return;
         }
+        // EPIPE (читатель ушёл), прочие ошибки — закрываем, при следующем сообщении откроем заново
+        observer_broken(sub, err);
+        return;
+    }
+}
+
+// Отправка уже сформированного сообщения подписчикам, отобранным последним observers_select
+void send_to_selected(const std::string &msg, uint64_t seq = 0) {
+    uint64_t t0 = trace_begin();
+    int n = 0;
+    for (ObserverSub &sub : g_subs)
+        if (sub.selected) {
+            send_to_observer(msg, sub, seq);
+            n++;
+        }
+    trace_end("fanout", t0, "observers", n);
+}
+
+// Досылка очередей медленных наблюдателей; вызывается из рабочих циклов и никогда не ждёт
+void observers_flush() {
+    for (ObserverSub &sub : g_subs) {
+        auto it = g_queues.find(sub.fifo);
+        if (it == g_queues.end() || queue_empty(it->second) || sub.fd == -1) continue;
+        int err = queue_flush(sub.fd, it->second);
+        if (err) observer_broken(sub, err);
+    }
+}
+
+bool observers_pending() {
+    for (auto &kv : g_queues)
+        if (!queue_empty(kv.second)) return true;
+    return false;
+}
+
+// Перед выходом: даём наблюдателям дочитать очередь, но не дольше timeout_ms
+void observers_drain(int timeout_ms) {
+    for (int t = 0; t < timeout_ms / 10 && observers_pending(); ++t) {
+        observers_flush();
+        if (observers_pending()) usleep(10000);
     }
 }
 
-// Надёжная отправка сообщения в наблюдатель. Всегда возвращает true если хотя бы одно действие выполнено:
-// - сообщение напечатано в консоль до вызова этой функции (не здесь),
-// - функция пытается отправить в FIFO; при ошибке логирует в stderr и закрывает fifo_fd при необходимости.
+// Окно истории для наблюдателей, подключившихся посреди прогона. Отдельный сегмент
+// /treasure_demo_history (создаёт менеджер): кольцо последних событий, в которое каждый
+// публикатор пишет событие один раз, независимо от числа наблюдателей. Номер события
+// уходит в FIFO префиксом "@<seq> ", по нему observer склеивает историю с живым потоком.
+// Слот защищён seqlock: state = 2*seq+1 — пишется, 2*seq+2 — готов.
+constexpr int HISTORY_TEXT = 232;
+struct HistoryEntry {
+    uint64_t state;
+    uint32_t type;
+    int32_t group_id;
+    uint8_t found;
+    uint8_t pad;
+    uint16_t len;
+    char text[HISTORY_TEXT];
+};
+
+struct HistoryRing {
+    uint64_t head;           // номер следующего события
+    uint32_t slots;
+    uint32_t entry_size;
+    HistoryEntry entries[1];
+};
+
+static const char *HISTORY_SHM = "/treasure_demo_history";
+static HistoryRing *g_history = nullptr;
+
+// Возвращает номер события + 1 (0 — история выключена)
+uint64_t history_record(unsigned type, int group_id, bool found, const std::string &msg) {
+    if (!g_history) return 0;
+    uint64_t seq = __atomic_fetch_add(&g_history->head, 1, __ATOMIC_ACQ_REL);
+    HistoryEntry &e = g_history->entries[seq % g_history->slots];
+    __atomic_store_n(&e.state, 2 * seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    e.type = type;
+    e.group_id = group_id;
+    e.found = found ? 1 : 0;
+    e.len = (uint16_t)min(msg.size(), (size_t)HISTORY_TEXT);
+    memcpy(e.text, msg.data(), e.len);
+    __atomic_store_n(&e.state, 2 * seq + 2, __ATOMIC_RELEASE);
+    return seq + 1;
+}
+
+// Подключение к сегменту истории, если менеджер его создал
+size_t history_attach() {
+    int fd = shm_open(HISTORY_SHM, O_RDWR, 0);
+    if (fd == -1) return 0;
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size > offsetof(HistoryRing, entries))
+        p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return 0;
+    g_history = (HistoryRing*)p;
+    return st.st_size;
+}
+
+// Нужно ли вообще формировать сообщение: его ждёт наблюдатель или окно истории.
+// Окно истории включается только явно (--history N у менеджера): иначе каждое событие
+// форматировалось бы, даже если ни один фильтр наблюдателей его не пропускает.
+// Отбирает подписчиков для следующего publish_selected.
+bool publish_wanted(unsigned type, int group_id, bool found) {
+    bool selected = observers_select(type, group_id, found);
+    return selected || g_history != nullptr;
+}
+
+void publish_selected(unsigned type, int group_id, bool found, const std::string &msg) {
+    uint64_t seq = history_record(type, group_id, found, msg);
+    bool any = false;
+    for (ObserverSub &sub : g_subs) any = any || sub.selected;
+    if (!any) return;
+    send_to_selected(msg, seq);
+}
+
+void publish(unsigned type, int group_id, bool found, const std::string &msg) {
+    if (publish_wanted(type, group_id, found)) publish_selected(type, group_id, found, msg);
+}
+
+// Служебное сообщение (EV_INFO) всем подписанным на него наблюдателям
 void send_to_observers(const std::string &msg) {
-    const char* dir = "/tmp";
-    DIR* dp = opendir(dir);
-    if (!dp) return;
+    publish(EV_INFO, -1, false, msg);
+}
 
-    struct dirent* ent;
-    while ((ent = readdir(dp)) != nullptr) {
-        std::string name = ent->d_name;
-        if (name.find("treasure_observer_fifo_") == 0) {
-            std::string path = std::string("/tmp/") + name;
-            send_to_observer(msg, path);
+// ---------------- Подключаемое ядро ----------------
+// .so должна экспортировать (extern "C"):
+//   int  init(const char* arg);
+//   int  process_section(int section, const void* input, size_t input_len,
+//                        void* result, size_t result_cap, size_t* result_len);  // 1 — найдено, 0 — пусто, <0 — ошибка
+//   void fini();
+typedef int (*kernel_init_fn)(const char*);
+typedef int (*kernel_process_fn)(int, const void*, size_t, void*, size_t, size_t*);
+typedef void (*kernel_fini_fn)();
+
+struct Kernel {
+    void* lib = nullptr;
+    kernel_init_fn init = nullptr;
+    kernel_process_fn process = nullptr;
+    kernel_fini_fn fini = nullptr;
+    // входной файл, отображённый только на чтение
+    void* map = nullptr;
+    size_t map_size = 0;
+    uint64_t count = 0;
+    const uint64_t* offsets = nullptr;
+    const unsigned char* data = nullptr;
+};
+
+// Освобождение без fini: для ошибок загрузки, когда init ещё не вызывался или не удался
+void kernel_release(Kernel& k) {
+    if(k.map) munmap(k.map, k.map_size);
+    if(k.lib) dlclose(k.lib);
+    k = Kernel();
+}
+
+bool load_kernel(Kernel& k, const char* so_path, const char* arg, const char* input_path) {
+    k.lib = dlopen(so_path, RTLD_NOW | RTLD_LOCAL);
+    if(!k.lib) {
+        cerr << "dlopen: " << dlerror() << "\n";
+        return false;
+    }
+    k.init = (kernel_init_fn)dlsym(k.lib, "init");
+    k.process = (kernel_process_fn)dlsym(k.lib, "process_section");
+    k.fini = (kernel_fini_fn)dlsym(k.lib, "fini");
+    if(!k.init || !k.process || !k.fini) {
+        cerr << "Ядро " << so_path << " должно экспортировать init/process_section/fini\n";
+        kernel_release(k);
+        return false;
+    }
+
+    int fd = open(input_path, O_RDONLY);
+    struct stat st;
+    if(fd == -1 || fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(InputHeader)) {
+        perror("open input");
+        if(fd != -1) close(fd);
+        kernel_release(k);
+        return false;
+    }
+    k.map_size = st.st_size;
+    k.map = mmap(nullptr, k.map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(k.map == MAP_FAILED) {
+        perror("mmap input");
+        k.map = nullptr;
+        kernel_release(k);
+        return false;
+    }
+    const InputHeader* hdr = (const InputHeader*)k.map;
+    // count сравнивается до умножения: иначе (count + 1) * 8 переполняется
+    size_t max_count = (k.map_size - sizeof(InputHeader)) / sizeof(uint64_t);
+    if(hdr->magic != INPUT_MAGIC || hdr->count >= max_count) {
+        cerr << "Неверный формат входного файла " << input_path << "\n";
+        kernel_release(k);
+        return false;
+    }
+    size_t table_end = sizeof(InputHeader) + (hdr->count + 1) * sizeof(uint64_t);
+    k.count = hdr->count;
+    k.offsets = (const uint64_t*)((const char*)k.map + sizeof(InputHeader));
+    k.data = (const unsigned char*)k.map + table_end;
+    // Смещения неубывающие и в пределах данных: иначе длина блока отрицательна
+    // (огромный size_t) или указатель выходит за отображение
+    uint64_t data_size = k.map_size - table_end;
+    for(uint64_t i = 0; i < k.count; ++i) {
+        if(k.offsets[i] > k.offsets[i + 1] || k.offsets[i + 1] > data_size) {
+            cerr << "Входной файл " << input_path << ": неверное смещение участка " << i
+                 << (k.offsets[i + 1] > data_size ? " (файл обрезан)" : "") << "\n";
+            kernel_release(k);
+            return false;
         }
     }
-    closedir(dp);
+    if(k.init(arg) != 0) {
+        cerr << "Ядро " << so_path << ": init завершился с ошибкой\n";
+        kernel_release(k);
+        return false;
+    }
+    return true;
+}
+
+void unload_kernel(Kernel& k) {
+    if(k.fini) k.fini();
+    kernel_release(k);
+}
+
+// Блок участка — указатель прямо в отображение входного файла
+bool kernel_blob(const Kernel& k, int section, const void*& p, size_t& len) {
+    if(section < 0 || (uint64_t)section >= k.count) return false;
+    p = k.data + k.offsets[section];
+    len = (size_t)(k.offsets[section + 1] - k.offsets[section]);
+    return true;
+}
+
+// make-input <file> <sections> <blob_bytes>: входной файл со случайными блоками
+int make_input(int argc, char* argv[]) {
+    if(argc < 5) {
+        cerr << "Usage: " << argv[0] << " make-input <file> <sections> <blob_bytes>\n";
+        return 1;
+    }
+    uint64_t count = stoull(argv[3]);
+    uint64_t blob = stoull(argv[4]);
+    ofstream out(argv[2], ios::binary);
+    if(!out) {
+        cerr << "Не удалось создать " << argv[2] << "\n";
+        return 1;
+    }
+    InputHeader hdr{INPUT_MAGIC, count};
+    out.write((const char*)&hdr, sizeof(hdr));
+    for(uint64_t i = 0; i <= count; ++i) {
+        uint64_t off = i * blob;
+        out.write((const char*)&off, sizeof(off));
+    }
+    vector<unsigned char> buf(blob);
+    uint64_t x = 0x2545F4914F6CDD1DULL;
+    for(uint64_t i = 0; i < count; ++i) {
+        for(auto& b : buf) {
+            x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+            b = (unsigned char)x;
+        }
+        out.write((const char*)buf.data(), (streamsize)blob);
+    }
+    cout << "Создан " << argv[2] << ": " << count << " участков по " << blob << " байт\n";
+    return 0;
+}
+
+// bench <kernel.so> <input> [sections] [kernel_arg]: пропускная способность ядра в одном процессе
+int bench_kernel(int argc, char* argv[]) {
+    if(argc < 4) {
+        cerr << "Usage: " << argv[0] << " bench <kernel.so> <input> [sections] [kernel_arg]\n";
+        return 1;
+    }
+    Kernel k;
+    if(!load_kernel(k, argv[2], argc >= 6 ? argv[5] : "", argv[3])) return 1;
+    uint64_t n = argc >= 5 ? stoull(argv[4]) : k.count;
+    if(n > k.count) n = k.count;
+    vector<unsigned char> result(64);
+    uint64_t bytes = 0, found = 0;
+    timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(uint64_t i = 0; i < n; ++i) {
+        const void* p = nullptr;
+        size_t len = 0, rlen;
+        kernel_blob(k, (int)i, p, len);
+        if(k.process((int)i, p, len, result.data(), result.size(), &rlen) > 0) found++;
+        bytes += len;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    cout << "[Bench] участков " << n << " за " << sec << " с: " << n / sec << " участков/с, "
+         << bytes / sec / (1024 * 1024) << " МиБ/с, найдено " << found << "\n";
+    unload_kernel(k);
+    return 0;
+}
+
+// ---------------- Сетевой режим ----------------
+// Протокол описан в manager_named.cpp: кадр NetHeader + payload, пачки участков и отчётов.
+enum NetMsg : uint8_t { NET_HELLO = 1, NET_PROFILE = 2, NET_REQ = 3, NET_BATCH = 4, NET_REPORTS = 5, NET_DONE = 6 };
+
+struct __attribute__((packed)) NetHeader {
+    uint32_t len;
+    uint8_t type;
+};
+
+struct __attribute__((packed)) NetReport {
+    int32_t section;
+    int32_t search_ms;
+    uint8_t found;
+    uint8_t result_len;
+    uint8_t result[16];
+};
+
+// Предел длины кадра — как у менеджера (NET_MAX_BATCH отчётов)
+constexpr int NET_MAX_BATCH = 4096;
+constexpr uint32_t NET_MAX_PAYLOAD = NET_MAX_BATCH * sizeof(NetReport);
+constexpr int NET_MAX_CREDITS = 64;
+
+int net_connect(const string& addr) {
+    if(addr.rfind("unix:", 0) == 0) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un ua{};
+        ua.sun_family = AF_UNIX;
+        strncpy(ua.sun_path, addr.c_str() + 5, sizeof(ua.sun_path) - 1);
+        if(fd == -1 || connect(fd, (sockaddr*)&ua, sizeof(ua)) == -1) {
+            perror("connect unix");
+            if(fd != -1) close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    size_t colon = addr.rfind(':');
+    if(colon == string::npos) return -1;
+    addrinfo hints{}, *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(addr.substr(0, colon).c_str(), addr.c_str() + colon + 1, &hints, &res) != 0) return -1;
+    int fd = -1;
+    for(addrinfo* ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if(fd != -1 && connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        if(fd != -1) close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if(fd == -1) {
+        perror("connect tcp");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+bool read_full(int fd, void* buf, size_t len) {
+    char* p = (char*)buf;
+    while(len > 0) {
+        ssize_t r = read(fd, p, len);
+        if(r == -1 && errno == EINTR && !g_terminate) continue;
+        if(r <= 0) return false;
+        p += r;
+        len -= (size_t)r;
+    }
+    return true;
+}
+
+bool write_full(int fd, const void* buf, size_t len) {
+    const char* p = (const char*)buf;
+    while(len > 0) {
+        ssize_t w = send(fd, p, len, MSG_NOSIGNAL);
+        if(w == -1 && errno == EINTR) continue;
+        if(w <= 0) return false;
+        p += w;
+        len -= (size_t)w;
+    }
+    return true;
+}
+
+void net_append(vector<char>& out, uint8_t type, const void* payload, uint32_t len) {
+    NetHeader h{len, type};
+    out.insert(out.end(), (const char*)&h, (const char*)&h + sizeof(h));
+    if(len) out.insert(out.end(), (const char*)payload, (const char*)payload + len);
+}
+
+// connect <адрес> [--depth N] [--kernel <so> --input <file> [--kernel-arg <arg>]]
+// Удалённый рабочий: держит до depth запрошенных пачек вперёд, чтобы следующая пачка
+// уже лежала в сокете, пока обрабатывается текущая.
+int run_remote(int argc, char* argv[]) {
+    if(argc < 3) {
+        cerr << "Usage: " << argv[0] << " connect <host:port|unix:path> [--depth N]"
+             << " [--kernel <lib.so> --input <file> [--kernel-arg <arg>]]\n";
+        return 1;
+    }
+    string addr = argv[2];
+    int depth = 2;
+    string kernel_path, kernel_arg, input_path;
+    for(int i = 3; i < argc; ++i) {
+        string arg = argv[i];
+        if(arg == "--depth" && i + 1 < argc) depth = min(max(1, stoi(argv[++i])), NET_MAX_CREDITS);
+        else if(arg == "--kernel" && i + 1 < argc) kernel_path = argv[++i];
+        else if(arg == "--kernel-arg" && i + 1 < argc) kernel_arg = argv[++i];
+        else if(arg == "--input" && i + 1 < argc) input_path = argv[++i];
+        else {
+            cerr << "Неизвестный ключ: " << arg << "\n";
+            return 1;
+        }
+    }
+    Kernel kernel;
+    if(!kernel_path.empty() && !load_kernel(kernel, kernel_path.c_str(), kernel_arg.c_str(), input_path.c_str()))
+        return 1;
+
+    int fd = net_connect(addr);
+    if(fd == -1) return 1;
+
+    srand((unsigned)time(nullptr) ^ getpid());
+    int32_t pid = getpid();
+    uint32_t want = (uint32_t)depth;
+    vector<char> out;
+    net_append(out, NET_HELLO, &pid, sizeof(pid));
+    net_append(out, NET_REQ, &want, sizeof(want));
+    write_full(fd, out.data(), out.size());
+
+    {
+        std::ostringstream oss;
+        oss << "[Worker pid=" << pid << "] подключён к " << addr << ", конвейер " << depth << " пачек\n";
+        cout << oss.str();
+        send_to_observers(oss.str());
+    }
+
+    int32_t profile[3] = {1000, 3000, 10};
+    int group_id = -1;   // слот, выданный менеджером
+    long sections_done = 0;
+    vector<char> payload;
+    vector<unsigned char> result(64);
+    while(!g_terminate) {
+        NetHeader h;
+        if(!read_full(fd, &h, sizeof(h))) break;
+        if(h.len > NET_MAX_PAYLOAD) {
+            cerr << "[Worker] кадр менеджера длиной " << h.len << " байт — ошибка протокола\n";
+            break;
+        }
+        payload.resize(h.len);
+        if(h.len && !read_full(fd, payload.data(), h.len)) break;
+        if(h.type == NET_PROFILE && h.len >= sizeof(profile)) {
+            memcpy(profile, payload.data(), sizeof(profile));
+            if(h.len >= sizeof(profile) + sizeof(int32_t))
+                memcpy(&group_id, payload.data() + sizeof(profile), sizeof(group_id));
+        } else if(h.type == NET_DONE) {
+            break;
+        } else if(h.type == NET_BATCH) {
+            size_t n = h.len / sizeof(int32_t);
+            vector<NetReport> reps(n);
+            for(size_t k = 0; k < n; ++k) {
+                int32_t section;
+                memcpy(&section, payload.data() + k * sizeof(int32_t), sizeof(section));
+                NetReport& r = reps[k];
+                memset(&r, 0, sizeof(r));
+                r.section = section;
+                timespec t0, t1;
+                clock_gettime(CLOCK_MONOTONIC, &t0);
+                const void* blob;
+                size_t blob_len, out_len = 0;
+                if(kernel.lib && kernel_blob(kernel, section, blob, blob_len)) {
+                    int rc = kernel.process(section, blob, blob_len, result.data(), result.size(), &out_len);
+                    r.found = rc > 0;
+                    r.result_len = (uint8_t)min(out_len, sizeof(r.result));
+                    memcpy(r.result, result.data(), r.result_len);
+                } else {
+                    int ms = profile[0] + rand() % (max(profile[1] - profile[0], 0) + 1);
+                    timespec req{ms / 1000, (long)(ms % 1000) * 1000000L}, rem;
+                    while(nanosleep(&req, &rem) == -1 && errno == EINTR && !g_terminate) req = rem;
+                    r.found = (rand() % 100) < profile[2];
+                }
+                clock_gettime(CLOCK_MONOTONIC, &t1);
+                r.search_ms = (int32_t)((t1.tv_sec - t0.tv_sec) * 1000 + (t1.tv_nsec - t0.tv_nsec) / 1000000);
+                std::ostringstream oss;
+                oss << "[Worker pid=" << pid << "] удалённо: участок #" << section
+                    << (r.found ? " (НАШЁЛ!)" : " (ничего)") << "\n";
+                cout << oss.str();
+                publish(EV_SENT, group_id, r.found, oss.str());
+            }
+            sections_done += (long)n;
+            // отчёты пачки и запрос следующей — одним write
+            out.clear();
+            uint32_t one = 1;
+            net_append(out, NET_REPORTS, reps.data(), (uint32_t)(reps.size() * sizeof(NetReport)));
+            net_append(out, NET_REQ, &one, sizeof(one));
+            if(!write_full(fd, out.data(), out.size())) break;
+        }
+    }
+    close(fd);
+    unload_kernel(kernel);
+    std::ostringstream oss;
+    oss << "[Worker pid=" << pid << "] удалённая работа завершена, участков: " << sections_done << "\n";
+    cout << oss.str();
+    send_to_observers(oss.str());
+    observers_drain(10000);
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
@@ -164,8 +1206,17 @@ int main(int argc, char* argv[]) {
     cout.setf(std::ios::unitbuf);
     setvbuf(stdout, nullptr, _IONBF, 0);
 
+    if(argc >= 2 && string(argv[1]) == "make-input") return make_input(argc, argv);
+    if(argc >= 2 && string(argv[1]) == "bench") return bench_kernel(argc, argv);
+    if(argc >= 2 && string(argv[1]) == "connect") {
+        signal(SIGTERM, sigint_handler);
+        signal(SIGINT, sigint_handler);
+        init_fifo_signal_handling();
+        return run_remote(argc, argv);
+    }
+
     if(argc < 2 || string(argv[1]) != "open"){
-        string usage = string("Usage: ") + argv[0] + " open\n";
+        string usage = string("Usage: ") + argv[0] + " open | connect <addr> | make-input ... | bench ...\n";
         cerr << usage;
         send_to_observers(usage);
         return 1;
@@ -173,11 +1224,13 @@ int main(int argc, char* argv[]) {
 
     signal(SIGTERM, sigint_handler);
     signal(SIGINT, sigint_handler);
+    signal(SIGUSR1, sigusr1_handler);
     // Игнорируем SIGPIPE, чтобы write() возвращал -1 на EPIPE
     init_fifo_signal_handling();
 
     string s_shm = get_shm_name();
-    int fd = shm_open(s_shm.c_str(), O_RDWR, 0);
+    int fd = open((string(HUGETLB_DIR) + s_shm).c_str(), O_RDWR);
+    if(fd == -1) fd = shm_open(s_shm.c_str(), O_RDWR, 0);
     if(fd == -1){
         string msg = string("[Worker ") + to_string(getpid()) + "] Ошибка shm_open — менеджер не запущен.\n";
         perror("shm_open");
@@ -202,8 +1255,12 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     close(fd);
+    size_t history_size = history_attach();
 
     Shared* shared = (Shared*)mem;
+    // горячую часть заполняем сразу, чтобы первый отчёт не ждал page fault'ов
+    segment_advise(mem, shm_sz, shared->map_kind, shared->map_prefault,
+                   offsetof(Shared, reports) + (size_t)shared->buf_size * sizeof(Report));
 
     string s_mutex = get_shm_name("_mutex");
     string s_report = get_shm_name("_report");
@@ -224,6 +1281,24 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // В режиме демона рабочий живёт между заданиями и ждёт участки на _work
+    sem_t* work_sem = SEM_FAILED;
+    if(shared->daemon) {
+        work_sem = sem_open(get_shm_name("_work").c_str(), 0);
+        if(work_sem == SEM_FAILED) {
+            perror("sem_open work (worker)");
+            send_to_observers("[Worker] sem_open _work failed.\n");
+            return 1;
+        }
+    }
+
+    // Ядро и входной файл, если менеджер их задал
+    Kernel kernel;
+    if(shared->kernel_path[0] && !load_kernel(kernel, shared->kernel_path, shared->kernel_arg, shared->input_path)) {
+        send_to_observers("[Worker] не удалось загрузить ядро.\n");
+        return 1;
+    }
+
     // Проверка лимита
     sem_wait(workers_mutex);
     if (shared->active_workers >= shared->max_workers) {
@@ -237,17 +1312,116 @@ int main(int argc, char* argv[]) {
     shared->active_workers++;
     sem_post(workers_mutex);
 
-    int group_id = (int)(getpid() % 10000);
+    // плотный id группы — номер слота в таблице статистики
+    StatsTable* stats = stats_open();
+    int group_id = stats ? stats_attach(stats, getpid(), 0) : -1;
+    if (group_id == -1) {
+        std::ostringstream oss;
+        oss << "[Worker pid=" << getpid() << "] нет свободного слота рабочего (их " << MAX_WORKER_SLOTS
+            << "). Завершение.\n";
+        cout << oss.str();
+        send_to_observers(oss.str());
+        sem_wait(workers_mutex);
+        shared->active_workers--;
+        sem_post(workers_mutex);
+        return 0;
+    }
+    WorkerStats* me = &stats->slots[group_id];
+    uint64_t* section_map = shared->section_offset ? (uint64_t*)((char*)mem + shared->section_offset) : nullptr;
+    int32_t* cost_samples = shared->cost_offset ? (int32_t*)((char*)mem + shared->cost_offset) : nullptr;
+    string trace_path = shared->trace_path;
+    if(!trace_path.empty()) {
+        g_trace = true;
+        trace_thread("слот " + to_string(group_id));
+    }
+    ReportRing ring;
+    ring.reports = shared->reports;
     srand((unsigned)time(nullptr) ^ getpid());
 
     {
         std::ostringstream start;
-        start << "[Worker pid=" << getpid() << "] Запущен. Начинаю поиск.\n";
+        start << "[Worker pid=" << getpid() << "] Запущен (слот " << group_id << "). Начинаю поиск.\n";
         cout << start.str();
         send_to_observers(start.str());
     }
 
+    // Запись в кольцо отчётов: ждём место, под report_mutex сверяем поколение кольца и пишем.
+    // false — ожидание прервано (shutdown) или ошибка.
+    auto put_report = [&](const Report& out) -> bool {
+        int sw;
+        uint64_t w0 = mono_ns();
+        uint64_t t_slot = trace_begin();
+        // сразу места нет — отмечаем для автоподбора размера кольца и ждём
+        if((sw = sem_trywait(slots_mutex)) == -1) {
+            __atomic_add_fetch(&shared->slots_blocked, 1, __ATOMIC_RELAXED);
+            while((sw = sem_wait(slots_mutex)) == -1 && errno == EINTR && !shared->shutdown) {}
+        }
+        if(sw == -1){
+            if(errno == EINTR) return false;
+            perror("sem_wait slots (worker)");
+            send_to_observers("[Worker] Ошибка sem_wait slots.\n");
+            return false;
+        }
+        trace_end("wait-slot", t_slot);
+        uint64_t t_enq = trace_begin();
+        if(sem_wait(report_mutex) == -1){
+            perror("sem_wait report_mutex (worker)");
+            send_to_observers("[Worker] Ошибка sem_wait report_mutex.\n");
+            sem_post(slots_mutex);
+            return false;
+        }
+
+        stat_add(me->blocked_ns, mono_ns() - w0);
+        stat_touch(me);
+
+        if(!ring_sync(ring, shared)) {
+            perror("ring remap (worker)");
+            send_to_observers("[Worker] не удалось отобразить новое поколение кольца.\n");
+            sem_post(report_mutex);
+            sem_post(slots_mutex);
+            return false;
+        }
+        ring.reports[shared->reports_prod_idx % shared->buf_size] = out;
+        shared->reports_prod_idx++;
+
+        sem_post(report_mutex);
+        sem_post(items_mutex);
+        trace_end("enqueue", t_enq, "section", out.section);
+        return true;
+    };
+
+    // Комбайнер пустых участков (--combine у менеджера): одна сводная запись на пачку
+    bool combine = shared->combine_every > 0;
+    struct {
+        int empties = 0;
+        long long ms = 0;
+        uint64_t since_ns = 0;
+    } comb;
+    comb.since_ns = mono_ns();
+    auto flush_combiner = [&]() -> bool {
+        if(comb.empties == 0) return true;
+        Report sum{};
+        sum.group_pid = getpid();
+        sum.group_id = group_id;
+        sum.section = -1;
+        sum.found = false;
+        sum.t = time(nullptr);
+        sum.search_ms = (int)min(comb.ms, (long long)INT_MAX);
+        sum.covered = comb.empties;
+        if(!put_report(sum)) return false;
+        std::ostringstream msg;
+        msg << "[Worker pid=" << getpid() << "] отправил сводку: пусто " << comb.empties << " участков, поиск "
+            << comb.ms << "ms\n";
+        cout << msg.str();
+        publish(EV_SENT, group_id, false, msg.str());
+        comb.empties = 0;
+        comb.ms = 0;
+        comb.since_ns = mono_ns();
+        return true;
+    };
+
     while(!g_terminate) {
+        observers_flush();
         if(shared->shutdown) {
             {
                 std::ostringstream oss;
@@ -257,82 +1431,197 @@ int main(int argc, char* argv[]) {
             }
             break;
         }
-
-        if(sem_wait(section_mutex) == -1) {
-            if(errno == EINTR) continue;
-            perror("sem_wait mutex (worker)");
-            send_to_observers("[Worker] Ошибка sem_wait mutex.\n");
+        if(g_retire) {
+            std::ostringstream oss;
+            oss << "[Worker pid=" << getpid() << "] отозван менеджером — завершаюсь.\n";
+            cout << oss.str();
+            send_to_observers(oss.str());
             break;
         }
 
-        int section = shared->next_section;
-        if(section >= shared->total_sections) {
+        int section = -1;
+        int job_id = 0;
+        int work_ms;
+        int found_pct = 10;
+        if(shared->daemon) {
+            // Режим демона: ждём невыданный участок любого задания (значение _work = их число)
+            uint64_t t_work = trace_begin();
+            if(sem_wait(work_sem) == -1) {
+                if(errno == EINTR) continue;
+                perror("sem_wait work (worker)");
+                send_to_observers("[Worker] Ошибка sem_wait work.\n");
+                break;
+            }
+            trace_end("wait-work", t_work);
+            if(shared->shutdown) continue;
+            // токен уже взят — захват участка не должен прерываться сигналом
+            uint64_t w0 = mono_ns();
+            uint64_t t_claim = trace_begin();
+            while(sem_wait(section_mutex) == -1 && errno == EINTR) {}
+            stat_add(me->blocked_ns, mono_ns() - w0);
+            // задания обслуживаются по кругу, чтобы несколько заданий шли вперемешку
+            JobSlot* job = nullptr;
+            for(int k = 0; k < MAX_JOBS && !job; ++k) {
+                int j = (shared->job_cursor + k) % MAX_JOBS;
+                if(shared->jobs[j].active && shared->jobs[j].next < shared->jobs[j].total) {
+                    job = &shared->jobs[j];
+                    shared->job_cursor = (j + 1) % MAX_JOBS;
+                }
+            }
+            if(!job) {
+                sem_post(section_mutex);
+                continue;
+            }
+            section = job->next++;
+            job_id = job->id;
+            work_ms = job->work_min_ms + rand() % (job->work_max_ms - job->work_min_ms + 1);
+            found_pct = job->found_pct;
             sem_post(section_mutex);
-            {
+            trace_end("claim", t_claim, "section", section);
+
+            std::ostringstream msg;
+            msg << "[Worker pid=" << getpid() << "] задание " << job_id << ": берёт участок #" << section
+                << ", ищет " << work_ms << "ms\n";
+            cout << msg.str();
+            publish(EV_CLAIM, group_id, false, msg.str());
+        } else {
+            uint64_t t_claim = trace_begin();
+            if(!shared->use_order) {
+                // участок берётся из карты состояния CAS'ом, без _mutex
+                section = section_claim(section_map, shared->total_sections, &shared->next_section);
+            } else {
+                // планировщик менеджера задаёт свой порядок выдачи участков — курсор по таблице под _mutex
+                uint64_t w0 = mono_ns();
+                int mw = sem_wait(section_mutex);
+                stat_add(me->blocked_ns, mono_ns() - w0);
+                if(mw == -1) {
+                    if(errno == EINTR) continue;
+                    perror("sem_wait mutex (worker)");
+                    send_to_observers("[Worker] Ошибка sem_wait mutex.\n");
+                    break;
+                }
+                int slot = shared->next_section;
+                if(slot < shared->total_sections) {
+                    section = ((int*)((char*)mem + shared->order_offset))[slot];
+                    section_take(section_map, section);
+                    shared->next_section++;
+                }
+                sem_post(section_mutex);
+            }
+            trace_end("claim", t_claim, "section", section);
+            if(section == -1) {
                 std::ostringstream oss;
                 oss << "[Worker pid=" << getpid() << "] участков больше нет — завершаюсь.\n";
                 cout << oss.str();
                 send_to_observers(oss.str());
+                break;
             }
-            break;
-        }
-        shared->next_section++;
-        sem_post(section_mutex);
 
-        int work = 1 + rand() % 3;
-        {
+            int work = 1 + rand() % 3;
+            work_ms = work * 1000;
             std::ostringstream msg;
-            msg << "[Worker pid=" << getpid() << "] берёт участок #" << section << ", ищет " << work << "s\n";
+            msg << "[Worker pid=" << getpid() << "] берёт участок #" << section;
+            if(kernel.lib) msg << ", обрабатывает ядром\n";
+            else msg << ", ищет " << work << "s\n";
             cout << msg.str();
-            send_to_observers(msg.str());
+            publish(EV_CLAIM, group_id, false, msg.str());
         }
 
-        sleep(work);
-        bool found = (rand() % 100) < 10;
+        stat_add(me->claimed, 1);
+        stat_touch(me);
 
-        if(sem_wait(slots_mutex) == -1){
-            if(errno == EINTR) continue;
-            perror("sem_wait slots (worker)");
-            send_to_observers("[Worker] Ошибка sem_wait slots.\n");
-            break;
-        }
-        if(sem_wait(report_mutex) == -1){
-            perror("sem_wait report_mutex (worker)");
-            send_to_observers("[Worker] Ошибка sem_wait report_mutex.\n");
-            sem_post(slots_mutex);
-            break;
+        // SIGUSR1 (отзыв) не должен укорачивать поиск — досыпаем остаток
+        timespec t_begin, t_end;
+        clock_gettime(CLOCK_MONOTONIC, &t_begin);
+        bool found;
+        int result_len = 0;
+        if(kernel.lib) {
+            // вход — прямо из отображения файла, результат — прямо в общую область SHM
+            const void* blob;
+            size_t blob_len, out_len = 0;
+            unsigned char* result = (unsigned char*)mem + shared->results_offset +
+                                    (size_t)section * shared->result_size;
+            int rc = kernel_blob(kernel, section, blob, blob_len)
+                         ? kernel.process(section, blob, blob_len, result, (size_t)shared->result_size, &out_len)
+                         : -1;
+            found = rc > 0;
+            result_len = rc < 0 ? 0 : (int)out_len;
+        } else {
+            timespec req{work_ms / 1000, (long)(work_ms % 1000) * 1000000L}, rem;
+            while(nanosleep(&req, &rem) == -1 && errno == EINTR && !g_terminate) req = rem;
+            found = (rand() % 100) < found_pct;
         }
+        clock_gettime(CLOCK_MONOTONIC, &t_end);
+        if(g_trace)
+            trace_end("search", (uint64_t)t_begin.tv_sec * 1000000000ull + t_begin.tv_nsec, "section", section);
+        int search_ms = (int)((t_end.tv_sec - t_begin.tv_sec) * 1000 + (t_end.tv_nsec - t_begin.tv_nsec) / 1000000);
+        stat_add(me->busy_ns, (uint64_t)(t_end.tv_sec - t_begin.tv_sec) * 1000000000ull + t_end.tv_nsec - t_begin.tv_nsec);
+        if(found) stat_add(me->found, 1);
+        if(section_map) section_done(section_map, section);
 
-        int idx = shared->reports_prod_idx % shared->buf_size;
-        Report* rep = &shared->reports[idx];
-        rep->group_pid = getpid();
-        rep->group_id = group_id;
-        rep->section = section;
-        rep->found = found;
-        rep->t = time(nullptr);
-        shared->reports_prod_idx++;
+        Report out{};
+        out.group_pid = getpid();
+        out.group_id = group_id;
+        out.section = section;
+        out.found = found;
+        out.t = time(nullptr);
+        out.search_ms = search_ms;
+        out.job_id = job_id;
+        out.result_len = result_len;
+        out.covered = 1;
 
-        sem_post(report_mutex);
-        sem_post(items_mutex);
+        // Комбайнер: пустые участки копятся в сводку, по отдельности уходят только находки
+        if(combine && !found) {
+            // сводку по участкам не разложить: время участка для журнала стоимостей пишем отдельно,
+            // менеджер увидит его не позже сводки (она идёт через семафоры кольца)
+            if(cost_samples && section >= 0) __atomic_store_n(&cost_samples[section], search_ms, __ATOMIC_RELAXED);
+            comb.empties++;
+            comb.ms += search_ms;
+            if(comb.empties >= shared->combine_every || mono_ns() - comb.since_ns >= (uint64_t)shared->combine_ms * 1000000ull) {
+                if(!flush_combiner()) break;
+            }
+            if(!kernel.lib) sleep(rand() % 2);
+            continue;
+        }
 
+        // участок уже взят — при EINTR повторяем ожидание, иначе отчёт потеряется
+        if(!put_report(out)) break;
 
         {
             std::ostringstream report;
             report << "[Worker pid=" << getpid() << "] отправил отчёт по участку #" << section
                 << (found ? " (НАШЁЛ!)" : " (ничего)") << "\n";
             cout << report.str();
-            send_to_observers(report.str());
+            publish(EV_SENT, group_id, found, report.str());
         }
 
-        sleep(rand() % 2);
+        if(!shared->daemon && !kernel.lib) sleep(rand() % 2);
     }
 
+    // недосланная сводка: без неё менеджер не досчитает участки
+    if(combine && !shared->shutdown) flush_combiner();
+
+    // освобождаем место в лимите групп, чтобы менеджер/оператор мог запустить замену
+    sem_wait(workers_mutex);
+    shared->active_workers--;
+    sem_post(workers_mutex);
+    __atomic_add_fetch(&shared->observer_suppressed, g_suppressed, __ATOMIC_RELAXED);
+    stats_detach(stats, group_id);
+    munmap(stats, sizeof(StatsTable));
+    if(ring.map_size) munmap(ring.reports, ring.map_size);
+
     sem_close(section_mutex);
     sem_close(report_mutex);
     sem_close(items_mutex);
     sem_close(slots_mutex);
     sem_close(workers_mutex);
+    if(work_sem != SEM_FAILED) sem_close(work_sem);
+    unload_kernel(kernel);
     munmap(mem, shm_sz);
+    if(g_history) {
+        munmap(g_history, history_size);
+        g_history = nullptr;   // дальше сообщения идут только в FIFO
+    }
 
     {
         std::ostringstream oss;
@@ -340,5 +1629,7 @@ int main(int argc, char* argv[]) {
         cout << oss.str();
         send_to_observers(oss.str());
     }
+    observers_drain(10000);
+    trace_dump(trace_path, "worker_named слот " + to_string(group_id));
     return 0;
 }
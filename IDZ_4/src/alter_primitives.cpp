@@ -1,165 +1,38 @@
-#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
 #include <ctime>
-#include <fstream>
 #include <iostream>
-#include <vector>
-#include <atomic>
+#include <string>
 
-#include <ostream>
-#include <pthread.h>
-#include <semaphore.h>
 #include <signal.h>
-#include <unistd.h>
 
-using namespace std;
-
-// Параметры генерации случайных чисел
-constexpr int MIN_GROUP_DELAY = 200;
-constexpr int MAX_GROUP_DELAY = 1500;
-
-// Параметры запуска
-int NUM_SECTIONS = 20; // Кол-во участков
-int NUM_GROUPS = 5;    // Кол-во поисковых групп
-double TREASURE_PROB = 0.05;
-std::ofstream outFile;
-
-// Глобальные данные
-atomic<int> next_section(0);
-int *section_taken = nullptr;
-
-// Мьютексы
-pthread_mutex_t mutex_alloc;
-pthread_mutex_t mutex_reports;
-
-// Условная переменная
-pthread_cond_t cond_report;
-
-// Структура доклада
-struct Report {
-  int group_id;
-  int section_id;
-  int found;
-  int search_time;
-};
-
-// Массив докладов
-Report *reports = nullptr;
-atomic<int> reports_count(0);
-
-// Вывод сообщений
-void log_msg(const string &msg) {
-  cout << msg << endl;
-  if (outFile) {
-    outFile << msg << "\n";
-  }
-}
-
-// Обработка сигналов
-static volatile sig_atomic_t g_terminate = 0;
-void sigint_handler(int) { g_terminate = 1; }
-
-// Поток группы
-void *group_thread(void *arg) {
-  int group_id = (int)(long)arg;
-
-  int section_id = -1;
-  while (!g_terminate) {
-    // Выдаём участок
-    pthread_mutex_lock(&mutex_alloc);
-    if (next_section >= NUM_SECTIONS) {
-      pthread_mutex_unlock(&mutex_alloc);
-      break;
-    }
-    section_id = next_section.fetch_add(1);
-    section_taken[section_id] = 1;
-
-    pthread_mutex_unlock(&mutex_alloc);
-
-    log_msg("[Группа " + to_string(group_id) + "] Вышла на участок " +
-            to_string(section_id));
+#include "expedition.h"
 
-    // Симуляция поиска
-    int t = rand() % (MAX_GROUP_DELAY - MIN_GROUP_DELAY) + MIN_GROUP_DELAY;
-    usleep(t * 1000);
-
-    // Найдено сокровище?
-    double r = (double)rand() / RAND_MAX;
-    int found = (r < TREASURE_PROB);
-
-    int idx = reports_count.fetch_add(1);
-    reports[idx] = {group_id, section_id, found, t};
+using namespace std;
 
-    // Сохраняем доклад
-    pthread_mutex_lock(&mutex_reports);
-    pthread_cond_signal(&cond_report);
-    pthread_mutex_unlock(&mutex_reports);
-  }
+// Альтернативная версия: та же экспедиция из expedition.h, доклады идут через
+// ограниченную lock-free очередь Вьюкова с ожиданием на условных переменных
+// (политика LockFreeSync) вместо массива под мьютексом и семафора.
 
-  log_msg("[Группа " + to_string(group_id) + "] завершила работу.");
-  return nullptr;
-}
+// Стресс-тест (-x/--stress): поиск без задержки и без вывода (g_bench),
+// Сильвер проверяет, что каждый участок доложен ровно один раз
+bool g_stress = false;
+int *section_seen = nullptr;
 
-// Поток Сильвера (главный)
-void *silver_manager(void *) {
-  int processed = 0;
-  int found_total = 0;
-  
-  pthread_mutex_lock(&mutex_reports);
-  while (processed < NUM_SECTIONS && !g_terminate) {
-    // Ждём доклад
-    pthread_cond_wait(&cond_report, &mutex_reports);
-
-    // Берём один доклад
-    Report rep = reports[processed++];
-    pthread_mutex_unlock(&mutex_reports);
-
-    if (rep.found)
-      found_total++;
-
-    log_msg("[Сильвер] Доклад от группы " + to_string(rep.group_id) +
-            ": участок " + to_string(rep.section_id) + ", время " +
-            to_string(rep.search_time) + " ms, " +
-            (rep.found ? "СОКРОВИЩЕ НАЙДЕНО!" : "пусто"));
-  }
+void silver_report(const Report &rep, int, int &found_total) {
+  if (g_stress && rep.section_id >= 0 && rep.section_id < NUM_SECTIONS)
+    section_seen[rep.section_id]++;
 
-  log_msg("[Сильвер] Работа завершена. Найдено кладов: " +
-          to_string(found_total));
+  if (rep.found)
+    found_total++;
 
-  return nullptr;
+  log_event("[Сильвер] Доклад от группы %d: участок %d, время %d ms, %s",
+            rep.group_id, rep.section_id, rep.search_time,
+            rep.found ? "СОКРОВИЩЕ НАЙДЕНО!" : "пусто");
 }
 
-void read_args_from_file(char *&arg) {
-  // Открываем файл, который содержит параметры
-  ifstream inFile(arg);
-  if (!inFile) {
-    cerr << "Ошибка открытия файла " << arg << endl;
-    exit(1);
-  }
-
-  vector<string> params;
-  string token;
-  while (inFile >> token) {
-    params.push_back(token);
-  }
-  if (params.size() < 2 || params.size() > 3) {
-    cerr << "Ошибка структуры входного файла: " << arg
-         << " <кол-во групп> <кол-во участков> [файл для вывода]" << endl;
-    exit(1);
-  }
-  NUM_GROUPS = stoi(params[0]);
-  NUM_SECTIONS = stoi(params[1]);
-
-  // Закрывай файл
-  if (inFile) {
-    inFile.close();
-  }
-  if (params.size() == 3) {
-    outFile.open(params[2]);
-    if (!outFile) {
-      cerr << "Ошибка открытия файла для вывода " << params[2] << endl;
-      exit(1);
-    }
-  }
+void silver_finish(int found_total) {
+  log_msg("[Сильвер] Работа завершена. Найдено кладов: %d", found_total);
 }
 
 int main(int argc, char *argv[]) {
@@ -172,6 +45,11 @@ int main(int argc, char *argv[]) {
     } else if (arg == "-i" || arg == "--input-file") {
       read_args_from_file(argv[++i]);
       break;
+    } else if (arg == "--seed") {
+      g_seed = stoull(argv[++i]);
+    } else if (arg == "-x" || arg == "--stress") {
+      g_stress = true;
+      g_bench = true;
     } else if (arg == "-o" || arg == "--output-file") {
       outFile.open(argv[++i]);
       if (!outFile) {
@@ -192,47 +70,54 @@ int main(int argc, char *argv[]) {
   signal(SIGTERM, sigint_handler);
   signal(SIGINT, sigint_handler);
 
-  // Инициализация генератора случайных чисел
-  srand(time(nullptr));
+  // Зерно запуска: с ним прогон повторяет те же времена поиска и находки
+  if (g_seed == 0)
+    g_seed = (uint64_t)time(nullptr);
 
   // Подготовка данных
-  section_taken = new int[NUM_SECTIONS]();
-  reports = new Report[NUM_SECTIONS];
-  reports_count = 0;
-
-  pthread_mutex_init(&mutex_alloc, nullptr);
-  pthread_mutex_init(&mutex_reports, nullptr);
-  pthread_cond_init(&cond_report, nullptr);
-
-  // Создаём потоки групп
-  pthread_t *threads = new pthread_t[NUM_GROUPS];
-  for (int i = 0; i < NUM_GROUPS; i++) {
-    pthread_create(&threads[i], nullptr, group_thread, (void *)(long)(i + 1));
-  }
-
-  // Управляющий поток (Сильвер)
-  pthread_t silver_thread;
-  pthread_create(&silver_thread, nullptr, silver_manager, nullptr);
-
-  // Ждём завершения всех групп
-  for (int i = 0; i < NUM_GROUPS; i++) {
-    pthread_join(threads[i], nullptr);
+  next_section = 0;
+  section_map = new uint64_t[section_words(NUM_SECTIONS)]();
+  section_seen = new int[NUM_SECTIONS]();
+
+  log_start();
+  log_msg("Зерно запуска: %llu (повтор: --seed %llu)",
+          (unsigned long long)g_seed, (unsigned long long)g_seed);
+
+  Expedition<LockFreeSync> exp;
+  uint64_t t_start = mono_ns();
+  exp.run();
+  uint64_t t_end = mono_ns();
+  log_stop();
+
+  int status = 0;
+  if (g_stress) {
+    int missing = 0, duplicated = 0;
+    for (int i = 0; i < NUM_SECTIONS; i++) {
+      if (section_seen[i] == 0)
+        missing++;
+      else if (section_seen[i] > 1)
+        duplicated++;
+    }
+    double sec = (t_end - t_start) / 1e9;
+    cout << "Стресс-тест: групп " << NUM_GROUPS << ", докладов " << NUM_SECTIONS
+         << ", " << (long)(NUM_SECTIONS / sec) << " докл./с" << endl;
+    cout << "  потеряно " << missing << ", повторов " << duplicated
+         << "; Сильвер засыпал " << exp.sync.silver_sleeps
+         << " раз, группы на полной очереди " << exp.sync.group_sleeps
+         << " раз" << endl;
+    if (missing || duplicated) {
+      cout << "ОШИБКА: не каждый доклад получен ровно один раз" << endl;
+      status = 1;
+    }
   }
 
-  // Ждём завершения Сильвера
-  pthread_join(silver_thread, nullptr);
-
   // Очистка
-  pthread_cond_destroy(&cond_report);
-  pthread_mutex_destroy(&mutex_alloc);
-  pthread_mutex_destroy(&mutex_reports);
-  delete[] section_taken;
-  delete[] reports;
-  delete[] threads;
+  delete[] section_map;
+  delete[] section_seen;
 
   if (outFile) {
     outFile.close();
   }
 
-  return 0;
+  return status;
 }
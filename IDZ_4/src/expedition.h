@@ -0,0 +1,1058 @@
+#pragma once
+
+// Экспедиция Сильвера, общая для treasure.cpp, alter_primitives.cpp и sync_policies.cpp:
+// параметры, доклад, трасса, фоновый логгер, генератор групп, политики доставки докладов
+// и шаблон Expedition<Sync>. Программы отличаются политикой, которой инстанцируют шаблон,
+// и тем, что Сильвер делает с докладом (silver_report/silver_finish определяет программа).
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../../IDZ_3/src/Grade4/section_map.h"
+
+// Параметры генерации случайных чисел
+constexpr int MIN_GROUP_DELAY = 200;
+constexpr int MAX_GROUP_DELAY = 1500;
+
+// Параметры запуска
+inline int NUM_SECTIONS = 20; // Кол-во участков
+inline int NUM_GROUPS = 5;    // Кол-во поисковых групп
+inline double TREASURE_PROB = 0.05;
+inline std::ofstream outFile;
+
+// Состояние участков: курсор поиска свободных и карта по 2 бита на участок.
+// Карту заводит и освобождает программа: treasure делит её с сопрограммами и симуляцией.
+inline int next_section = 0;
+inline uint64_t *section_map = nullptr;
+
+// Обработка сигналов
+inline volatile sig_atomic_t g_terminate = 0;
+inline void sigint_handler(int) { g_terminate = 1; }
+
+// Бенчмарк и стресс-тест: поиск без задержки и без вывода
+inline bool g_bench = false;
+
+// Структура доклада
+struct Report {
+  int group_id;
+  int section_id;
+  int found;
+  int search_time;
+};
+
+// Метка конца: группы 0 нет. Политика кладёт её в close() за всеми докладами.
+constexpr Report END_REPORT = {0, -1, 0, 0};
+
+inline uint64_t mono_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+inline long context_switches() {
+  rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_nvcsw + ru.ru_nivcsw;
+}
+
+// ---------------- Трассировка ----------------
+// Потоки групп и Сильвера пишут интервалы (claim, search, enqueue, wait, dequeue, format,
+// log) в свой буфер без блокировок; после join всех потоков trace_save сохраняет их в
+// формате Chrome trace-event (chrome://tracing, ui.perfetto.dev). Включает treasure -t.
+constexpr size_t TRACE_MAX_SPANS = 1 << 20; // на поток, сверх этого только счётчик
+
+struct TraceSpan {
+  const char *name;
+  uint64_t t0_ns;
+  uint64_t dur_ns;
+  const char *arg_name; // nullptr — без аргумента
+  int64_t arg;
+};
+
+struct TraceBuffer {
+  pid_t tid;
+  std::string thread_name;
+  std::vector<TraceSpan> spans;
+  uint64_t dropped = 0;
+};
+
+inline bool g_trace = false;
+inline pthread_mutex_t mutex_trace = PTHREAD_MUTEX_INITIALIZER; // только список буферов
+inline std::vector<TraceBuffer *> trace_buffers;
+inline thread_local TraceBuffer *t_trace = nullptr;
+
+inline TraceBuffer *trace_buffer() {
+  if (!t_trace) {
+    t_trace = new TraceBuffer();
+    t_trace->tid = (pid_t)syscall(SYS_gettid);
+    t_trace->spans.reserve(4096);
+    pthread_mutex_lock(&mutex_trace);
+    trace_buffers.push_back(t_trace);
+    pthread_mutex_unlock(&mutex_trace);
+  }
+  return t_trace;
+}
+
+inline void trace_thread(const std::string &name) {
+  if (g_trace)
+    trace_buffer()->thread_name = name;
+}
+
+inline uint64_t trace_begin() { return g_trace ? mono_ns() : 0; }
+
+inline void trace_end(const char *name, uint64_t t0,
+                      const char *arg_name = nullptr, int64_t arg = 0) {
+  if (!g_trace || t0 == 0)
+    return;
+  uint64_t now = mono_ns();
+  TraceBuffer *b = trace_buffer();
+  if (b->spans.size() >= TRACE_MAX_SPANS) {
+    b->dropped++;
+    return;
+  }
+  b->spans.push_back({name, t0, now - t0, arg_name, arg});
+}
+
+// Вызывается после join: буферы больше никто не пишет
+inline bool trace_save(const std::string &path) {
+  std::ofstream out(path);
+  if (!out)
+    return false;
+  int pid = getpid();
+  uint64_t dropped = 0;
+  char line[512];
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  snprintf(line, sizeof(line),
+           "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"tid\":%d,"
+           "\"args\":{\"name\":\"treasure\"}}",
+           pid, pid);
+  out << line;
+  for (TraceBuffer *b : trace_buffers) {
+    snprintf(line, sizeof(line),
+             ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,"
+             "\"args\":{\"name\":\"%s\"}}",
+             pid, (int)b->tid, b->thread_name.c_str());
+    out << line;
+    for (const TraceSpan &s : b->spans) {
+      int n = snprintf(line, sizeof(line),
+                       ",\n{\"ph\":\"X\",\"cat\":\"treasure\",\"name\":\"%s\","
+                       "\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                       s.name, pid, (int)b->tid, s.t0_ns / 1e3, s.dur_ns / 1e3);
+      if (s.arg_name)
+        snprintf(line + n, sizeof(line) - n, ",\"args\":{\"%s\":%lld}}",
+                 s.arg_name, (long long)s.arg);
+      else
+        snprintf(line + n, sizeof(line) - n, "}");
+      out << line;
+    }
+    dropped += b->dropped;
+    delete b;
+  }
+  trace_buffers.clear();
+  out << "\n]}\n";
+  if (dropped)
+    std::cerr << "Трасса: буфер потока переполнен, не записано интервалов: "
+              << dropped << std::endl;
+  return (bool)out;
+}
+
+// ---------------- Фоновый логгер ----------------
+// Поток форматирует строку в свой thread_local буфер и кладёт её в ограниченную
+// lock-free очередь (номер seq в каждой ячейке, как у LockFreeSync ниже).
+// cout и outFile трогает только поток логгера: забирает строки пачкой, пишет пачку
+// одним вызовом и сбрасывает вывод, когда очередь опустела. Спит до LOG_FLUSH_MS;
+// раньше его будят, только если очередь заполнилась на четверть.
+// log_stop() дожидается, пока логгер выпишет всё до последней строки.
+// До log_start() и после log_stop() строка пишется сразу в вызывающем потоке.
+constexpr unsigned LOG_CAPACITY = 4096; // степень двойки
+constexpr unsigned LOG_LINE = 248;
+constexpr int LOG_FLUSH_MS = 20;
+constexpr size_t LOG_BATCH = 64 * 1024;
+
+struct LogCell {
+  unsigned seq;
+  unsigned len;
+  char text[LOG_LINE];
+};
+
+struct LogQueue {
+  LogCell cells[LOG_CAPACITY];
+  alignas(64) unsigned enqueue_pos = 0;
+  alignas(64) unsigned dequeue_pos = 0; // пишет только логгер
+};
+
+inline LogQueue *log_queue = nullptr;
+inline pthread_t log_thread;
+inline int log_running = 0;
+inline int log_stopping = 0;
+inline int log_sleeping = 0;
+inline pthread_mutex_t mutex_log = PTHREAD_MUTEX_INITIALIZER; // только для сна логгера
+inline pthread_cond_t cond_log = PTHREAD_COND_INITIALIZER;
+
+inline void log_wake() {
+  if (__atomic_load_n(&log_sleeping, __ATOMIC_RELAXED)) {
+    pthread_mutex_lock(&mutex_log);
+    pthread_cond_signal(&cond_log);
+    pthread_mutex_unlock(&mutex_log);
+  }
+}
+
+inline void log_push(const char *text, unsigned len) {
+  LogQueue &q = *log_queue;
+  unsigned pos = __atomic_load_n(&q.enqueue_pos, __ATOMIC_RELAXED);
+  for (;;) {
+    LogCell &cell = q.cells[pos % LOG_CAPACITY];
+    int diff = (int)(__atomic_load_n(&cell.seq, __ATOMIC_ACQUIRE) - pos);
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&q.enqueue_pos, &pos, pos + 1, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        memcpy(cell.text, text, len);
+        cell.len = len;
+        __atomic_store_n(&cell.seq, pos + 1, __ATOMIC_RELEASE);
+        break;
+      }
+    } else if (diff < 0) {
+      // очередь полна: строки не теряем, ждём логгер
+      log_wake();
+      sched_yield();
+      pos = __atomic_load_n(&q.enqueue_pos, __ATOMIC_RELAXED);
+    } else {
+      pos = __atomic_load_n(&q.enqueue_pos, __ATOMIC_RELAXED);
+    }
+  }
+  if (pos + 1 - __atomic_load_n(&q.dequeue_pos, __ATOMIC_RELAXED) >=
+      LOG_CAPACITY / 4)
+    log_wake();
+}
+
+inline void log_flush_batch(std::string &batch) {
+  if (batch.empty())
+    return;
+  std::cout.write(batch.data(), batch.size());
+  if (outFile)
+    outFile.write(batch.data(), batch.size());
+  batch.clear();
+}
+
+inline void *log_writer(void *) {
+  LogQueue &q = *log_queue;
+  std::string batch;
+  batch.reserve(LOG_BATCH + LOG_LINE);
+  for (;;) {
+    // флаг читаем до разбора: всё, что опубликовано до log_stop, будет выписано
+    int stopping = __atomic_load_n(&log_stopping, __ATOMIC_ACQUIRE);
+    unsigned taken = 0;
+    for (;;) {
+      LogCell &cell = q.cells[q.dequeue_pos % LOG_CAPACITY];
+      if (__atomic_load_n(&cell.seq, __ATOMIC_ACQUIRE) != q.dequeue_pos + 1)
+        break;
+      batch.append(cell.text, cell.len);
+      __atomic_store_n(&cell.seq, q.dequeue_pos + LOG_CAPACITY,
+                       __ATOMIC_RELEASE);
+      __atomic_store_n(&q.dequeue_pos, q.dequeue_pos + 1, __ATOMIC_RELAXED);
+      taken++;
+      if (batch.size() >= LOG_BATCH)
+        log_flush_batch(batch);
+    }
+    log_flush_batch(batch);
+    if (taken > 0)
+      continue;
+
+    // Очередь пуста: сбрасываем вывод и спим
+    std::cout.flush();
+    if (outFile)
+      outFile.flush();
+    if (stopping)
+      break;
+    pthread_mutex_lock(&mutex_log);
+    __atomic_store_n(&log_sleeping, 1, __ATOMIC_RELAXED);
+    timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += LOG_FLUSH_MS * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+    if (!__atomic_load_n(&log_stopping, __ATOMIC_ACQUIRE))
+      pthread_cond_timedwait(&cond_log, &mutex_log, &deadline);
+    __atomic_store_n(&log_sleeping, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&mutex_log);
+  }
+  return nullptr;
+}
+
+inline void log_start() {
+  log_queue = new LogQueue();
+  for (unsigned i = 0; i < LOG_CAPACITY; i++)
+    log_queue->cells[i].seq = i;
+  log_stopping = 0;
+  pthread_create(&log_thread, nullptr, log_writer, nullptr);
+  log_running = 1;
+}
+
+inline void log_stop() {
+  if (!log_running)
+    return;
+  __atomic_store_n(&log_stopping, 1, __ATOMIC_RELEASE);
+  pthread_mutex_lock(&mutex_log);
+  pthread_cond_signal(&cond_log);
+  pthread_mutex_unlock(&mutex_log);
+  pthread_join(log_thread, nullptr);
+  log_running = 0;
+  delete log_queue;
+  log_queue = nullptr;
+}
+
+inline bool g_silent = false; // симуляции treasure --check-sim идут без вывода
+
+// Вывод сообщений: форматирование в буфер потока, строка уходит логгеру
+inline void log_vmsg(const char *fmt, va_list ap) {
+  if (g_bench || g_silent)
+    return;
+  uint64_t t0 = trace_begin();
+  thread_local char line[LOG_LINE];
+  uint64_t t_fmt = trace_begin();
+  int n = vsnprintf(line, LOG_LINE - 1, fmt, ap);
+  trace_end("format", t_fmt);
+  if (n < 0)
+    n = 0;
+  if (n > (int)LOG_LINE - 2)
+    n = LOG_LINE - 2; // длинная строка обрезается
+  line[n++] = '\n';
+  if (log_running) {
+    log_push(line, n);
+  } else {
+    std::cout.write(line, n);
+    if (outFile)
+      outFile.write(line, n);
+  }
+  trace_end("log", t0);
+}
+
+inline void log_msg(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+inline void log_msg(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  log_vmsg(fmt, ap);
+  va_end(ap);
+}
+
+// Строки по каждому участку и докладу; --quiet оставляет только прогресс и итоги
+inline bool g_quiet = false;
+inline void log_event(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+inline void log_event(const char *fmt, ...) {
+  if (g_quiet)
+    return;
+  va_list ap;
+  va_start(ap, fmt);
+  log_vmsg(fmt, ap);
+  va_end(ap);
+}
+
+// ---------------- Генератор групп ----------------
+// xoshiro256** (Блэкман, Винья): детерминирован по зерну, состояние на
+// каждую группу, без общего замка как у rand(). Зерно разворачивается splitmix64.
+struct Xoshiro256 {
+  uint64_t s[4];
+
+  static uint64_t splitmix64(uint64_t &x) {
+    uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+  void seed(uint64_t seed) {
+    for (int i = 0; i < 4; i++)
+      s[i] = splitmix64(seed);
+  }
+  static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+  uint64_t next() {
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+  }
+  // [0, 1) из старших 53 бит
+  double uniform() { return (next() >> 11) * 0x1.0p-53; }
+  // [lo, hi) без перекоса по модулю (метод Лемира): старшие 32 бита произведения —
+  // результат; младшие меньше 2^32 mod n — значение из «лишнего» хвоста, повтор
+  int range(int lo, int hi) {
+    uint32_t n = (uint32_t)(hi - lo);
+    uint64_t m = (next() >> 32) * n;
+    uint32_t l = (uint32_t)m;
+    if (l < n) {
+      uint32_t t = -n % n;
+      while (l < t) {
+        m = (next() >> 32) * n;
+        l = (uint32_t)m;
+      }
+    }
+    return lo + (int)(m >> 32);
+  }
+};
+
+// Зерно запуска (--seed, иначе от времени; печатается при старте).
+// Группа g получает своё зерно seed * 0x100000001B3 + g, одинаково во всех режимах.
+inline uint64_t g_seed = 0;
+
+// Случайные величины поиска группы (время, находка), пачкой по SEARCH_BATCH.
+// Пачка заполняется одним циклом по копии состояния в регистрах. Порядок чисел тот же,
+// что при поштучных вызовах (время, находка, время, ...), поэтому от размера пачки
+// ход прогона не зависит. Находка — сравнение старших 53 бит с порогом без double.
+constexpr int SEARCH_BATCH = 64;
+struct SearchDraws {
+  Xoshiro256 rng;
+  uint64_t threshold; // (next() >> 11) < threshold <=> uniform() < TREASURE_PROB
+  int delay[SEARCH_BATCH];
+  uint8_t found[SEARCH_BATCH];
+  int pos = SEARCH_BATCH;
+
+  void seed(uint64_t run_seed, int group_id) {
+    rng.seed(run_seed * 0x100000001B3ULL + group_id);
+    threshold = (uint64_t)ceil(std::max(TREASURE_PROB, 0.0) * 0x1.0p53);
+    pos = SEARCH_BATCH;
+  }
+  void fill() {
+    Xoshiro256 r = rng;
+    for (int i = 0; i < SEARCH_BATCH; i++) {
+      delay[i] = r.range(MIN_GROUP_DELAY, MAX_GROUP_DELAY);
+      found[i] = (r.next() >> 11) < threshold;
+    }
+    rng = r;
+    pos = 0;
+  }
+  void next(int &t, int &f) {
+    if (pos == SEARCH_BATCH)
+      fill();
+    t = delay[pos];
+    f = found[pos];
+    pos++;
+  }
+};
+
+inline void read_args_from_file(char *&arg) {
+  // Открываем файл, который содержит параметры
+  std::ifstream inFile(arg);
+  if (!inFile) {
+    std::cerr << "Ошибка открытия файла " << arg << std::endl;
+    exit(1);
+  }
+
+  std::vector<std::string> params;
+  std::string token;
+  while (inFile >> token) {
+    params.push_back(token);
+  }
+  if (params.size() < 2 || params.size() > 3) {
+    std::cerr << "Ошибка структуры входного файла: " << arg
+              << " <кол-во групп> <кол-во участков> [файл для вывода]"
+              << std::endl;
+    exit(1);
+  }
+  NUM_GROUPS = stoi(params[0]);
+  NUM_SECTIONS = stoi(params[1]);
+
+  // Закрывай файл
+  if (inFile) {
+    inFile.close();
+  }
+  if (params.size() == 3) {
+    outFile.open(params[2]);
+    if (!outFile) {
+      std::cerr << "Ошибка открытия файла для вывода " << params[2]
+                << std::endl;
+      exit(1);
+    }
+  }
+}
+
+// ---------------- Политики синхронизации ----------------
+// Как доклад группы доходит до Сильвера. Политика — класс с методами:
+//   init(groups, capacity) — перед прогоном, capacity = число участков + 1;
+//   push(rep)              — группа публикует доклад (может ждать, если места нет);
+//   pop(rep)               — Сильвер забирает доклад (ждёт, если докладов нет);
+//                            false — после close() докладов больше не будет;
+//   close()                — все группы вышли (в том числе раньше, по Ctrl+C);
+//   destroy()              — после прогона.
+// Политика — параметр шаблона, а не виртуальный класс: push/pop встраиваются в
+// потоки групп и Сильвера каждой специализации, в горячем пути нет косвенных вызовов.
+
+inline long futex(int *addr, int op, int val) {
+  return syscall(SYS_futex, addr, op, val, nullptr, nullptr, 0);
+}
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// Массив докладов под мьютексом, семафор на каждый доклад (основная версия treasure)
+struct MutexSemSync {
+  static constexpr const char *name = "mutex+sem";
+  pthread_mutex_t mutex;
+  sem_t items;
+  Report *reports = nullptr;
+  int tail = 0, head = 0;
+
+  void init(int, int capacity) {
+    reports = new Report[capacity];
+    tail = head = 0;
+    pthread_mutex_init(&mutex, nullptr);
+    sem_init(&items, 0, 0);
+  }
+  void push(const Report &rep) {
+    pthread_mutex_lock(&mutex);
+    reports[tail++] = rep;
+    pthread_mutex_unlock(&mutex);
+    sem_post(&items);
+  }
+  bool pop(Report &rep) {
+    uint64_t t_wait = trace_begin();
+    while (sem_wait(&items) == -1 && errno == EINTR) {
+    }
+    trace_end("wait", t_wait);
+    pthread_mutex_lock(&mutex);
+    rep = reports[head++];
+    pthread_mutex_unlock(&mutex);
+    return rep.group_id != 0;
+  }
+  void close() { push(END_REPORT); }
+  void destroy() {
+    sem_destroy(&items);
+    pthread_mutex_destroy(&mutex);
+    delete[] reports;
+  }
+};
+
+// Условная переменная с предикатом; сигнал, только если Сильвер ждёт
+struct CondVarSync {
+  static constexpr const char *name = "condvar";
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  Report *reports = nullptr;
+  int tail = 0, head = 0;
+  int waiting = 0; // Сильвер ждёт: сигналить имеет смысл только тогда
+
+  void init(int, int capacity) {
+    reports = new Report[capacity];
+    tail = head = waiting = 0;
+    pthread_mutex_init(&mutex, nullptr);
+    pthread_cond_init(&cond, nullptr);
+  }
+  void push(const Report &rep) {
+    pthread_mutex_lock(&mutex);
+    reports[tail++] = rep;
+    if (waiting)
+      pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+  }
+  bool pop(Report &rep) {
+    pthread_mutex_lock(&mutex);
+    if (head == tail) {
+      uint64_t t_wait = trace_begin();
+      waiting = 1;
+      while (head == tail)
+        pthread_cond_wait(&cond, &mutex);
+      waiting = 0;
+      trace_end("wait", t_wait);
+    }
+    rep = reports[head++];
+    pthread_mutex_unlock(&mutex);
+    return rep.group_id != 0;
+  }
+  void close() { push(END_REPORT); }
+  void destroy() {
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&mutex);
+    delete[] reports;
+  }
+};
+
+// Ограниченная lock-free очередь Вьюкова (альтернативная версия, alter_primitives).
+// У каждой ячейки свой номер seq: seq == pos — ячейка свободна для записи номер pos,
+// seq == pos + 1 — в ней опубликован доклад номер pos. Доклад пишется до release-записи seq,
+// а читается после acquire-чтения seq, поэтому недописанный доклад Сильвер не увидит.
+// Позиции захватываются CAS'ом, мьютекс нужен только для сна на пустой или полной очереди.
+// Барьеры seq_cst в push и pop: либо спящая сторона при проверке предиката увидит
+// изменение очереди, либо будящая увидит флаг сна и возьмёт мьютекс.
+struct LockFreeSync {
+  static constexpr const char *name = "lockfree";
+  static constexpr size_t CAPACITY = 64; // степень двойки
+
+  struct Cell {
+    std::atomic<size_t> seq;
+    Report rep;
+  };
+  Cell cells[CAPACITY];
+  alignas(64) std::atomic<size_t> enqueue_pos;
+  alignas(64) std::atomic<size_t> dequeue_pos;
+  // флаги сна: кого будить после публикации или освобождения ячейки
+  alignas(64) std::atomic<int> silver_waiting;
+  std::atomic<int> groups_waiting;
+  std::atomic<long> silver_sleeps, group_sleeps; // для alter --stress
+  pthread_mutex_t mutex;
+  pthread_cond_t cond_report; // Сильвер ждёт доклад
+  pthread_cond_t cond_space;  // группы ждут свободную ячейку
+
+  void init(int, int) {
+    for (size_t i = 0; i < CAPACITY; i++)
+      cells[i].seq.store(i, std::memory_order_relaxed);
+    enqueue_pos.store(0);
+    dequeue_pos.store(0);
+    silver_waiting.store(0);
+    groups_waiting.store(0);
+    silver_sleeps.store(0);
+    group_sleeps.store(0);
+    pthread_mutex_init(&mutex, nullptr);
+    pthread_cond_init(&cond_report, nullptr);
+    pthread_cond_init(&cond_space, nullptr);
+  }
+
+  bool try_push(const Report &rep) {
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &cell = cells[pos & (CAPACITY - 1)];
+      intptr_t diff =
+          (intptr_t)cell.seq.load(std::memory_order_acquire) - (intptr_t)pos;
+      if (diff == 0) {
+        if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+          cell.rep = rep;
+          cell.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // очередь полна
+      } else {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Читатель один (Сильвер), CAS по dequeue_pos не нужен
+  bool try_pop(Report &rep) {
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    Cell &cell = cells[pos & (CAPACITY - 1)];
+    if (cell.seq.load(std::memory_order_acquire) != pos + 1)
+      return false;
+    rep = cell.rep;
+    dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+    cell.seq.store(pos + CAPACITY, std::memory_order_release);
+    return true;
+  }
+
+  // Предикаты для сна (проверяются под mutex)
+  bool full() {
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    return (intptr_t)cells[pos & (CAPACITY - 1)].seq.load(
+               std::memory_order_acquire) -
+               (intptr_t)pos <
+           0;
+  }
+  bool empty() {
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    return cells[pos & (CAPACITY - 1)].seq.load(std::memory_order_acquire) !=
+           pos + 1;
+  }
+
+  void push(const Report &rep) {
+    while (!try_push(rep)) {
+      pthread_mutex_lock(&mutex);
+      groups_waiting.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      while (full()) {
+        group_sleeps++;
+        pthread_cond_wait(&cond_space, &mutex);
+      }
+      groups_waiting.fetch_sub(1);
+      pthread_mutex_unlock(&mutex);
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (silver_waiting.load(std::memory_order_relaxed)) {
+      pthread_mutex_lock(&mutex);
+      pthread_cond_signal(&cond_report);
+      pthread_mutex_unlock(&mutex);
+    }
+  }
+
+  bool pop(Report &rep) {
+    while (!try_pop(rep)) {
+      uint64_t t_wait = trace_begin();
+      pthread_mutex_lock(&mutex);
+      silver_waiting.store(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      while (empty()) {
+        silver_sleeps++;
+        pthread_cond_wait(&cond_report, &mutex);
+      }
+      silver_waiting.store(0);
+      pthread_mutex_unlock(&mutex);
+      trace_end("wait", t_wait);
+    }
+    // Освободилась одна ячейка — будим одну группу, если они ждут
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (groups_waiting.load(std::memory_order_relaxed)) {
+      pthread_mutex_lock(&mutex);
+      pthread_cond_signal(&cond_space);
+      pthread_mutex_unlock(&mutex);
+    }
+    return rep.group_id != 0;
+  }
+
+  // Метка встаёт за последним докладом: Сильвер разбирает очередь до конца,
+  // так что место для неё освободится
+  void close() { push(END_REPORT); }
+
+  void destroy() {
+    pthread_cond_destroy(&cond_space);
+    pthread_cond_destroy(&cond_report);
+    pthread_mutex_destroy(&mutex);
+  }
+};
+
+// Слот на каждый доклад с флагом готовности: группа берёт слот fetch_add'ом,
+// пишет доклад и публикует флаг. Общая часть политик futex и spin.
+struct SlotArray {
+  struct Slot {
+    Report rep;
+    int ready; // 0 — пусто, 1 — опубликован; слово для futex
+  };
+  Slot *slots = nullptr;
+  alignas(64) std::atomic<int> tail;
+  alignas(64) int head = 0; // только Сильвер
+
+  void init_slots(int capacity) {
+    slots = new Slot[capacity]();
+    tail.store(0);
+    head = 0;
+  }
+  int publish(const Report &rep) {
+    int idx = tail.fetch_add(1, std::memory_order_relaxed);
+    slots[idx].rep = rep;
+    __atomic_store_n(&slots[idx].ready, 1, __ATOMIC_SEQ_CST);
+    return idx;
+  }
+  bool ready(int idx) {
+    return __atomic_load_n(&slots[idx].ready, __ATOMIC_SEQ_CST);
+  }
+};
+
+// futex напрямую: Сильвер спит на флаге своего следующего слота, группа будит
+// только если он спит (флаг sleeping), иначе доклад проходит без системного вызова
+struct FutexSync : SlotArray {
+  static constexpr const char *name = "futex";
+  alignas(64) int sleeping = 0;
+
+  void init(int, int capacity) {
+    init_slots(capacity);
+    sleeping = 0;
+  }
+  void push(const Report &rep) {
+    int idx = publish(rep);
+    if (__atomic_load_n(&sleeping, __ATOMIC_SEQ_CST) == idx + 1)
+      futex(&slots[idx].ready, FUTEX_WAKE_PRIVATE, 1);
+  }
+  bool pop(Report &rep) {
+    int idx = head++;
+    for (int spin = 0; spin < 100 && !ready(idx); spin++)
+      cpu_relax();
+    if (!ready(idx)) {
+      // sleeping = номер слота + 1: будит только его автор
+      uint64_t t_wait = trace_begin();
+      __atomic_store_n(&sleeping, idx + 1, __ATOMIC_SEQ_CST);
+      while (!ready(idx))
+        futex(&slots[idx].ready, FUTEX_WAIT_PRIVATE, 0);
+      __atomic_store_n(&sleeping, 0, __ATOMIC_RELAXED);
+      trace_end("wait", t_wait);
+    }
+    rep = slots[idx].rep;
+    return rep.group_id != 0;
+  }
+  void close() { push(END_REPORT); }
+  void destroy() { delete[] slots; }
+};
+
+// Ожидание без сна: Сильвер крутится на флаге слота, уступая процессор
+// (на одном ядре без sched_yield группа не получила бы время на публикацию)
+struct SpinSync : SlotArray {
+  static constexpr const char *name = "spin";
+
+  void init(int, int capacity) { init_slots(capacity); }
+  void push(const Report &rep) { publish(rep); }
+  bool pop(Report &rep) {
+    int idx = head++;
+    for (int spin = 0; !ready(idx); spin++) {
+      if (spin < 100)
+        cpu_relax();
+      else
+        sched_yield();
+    }
+    rep = slots[idx].rep;
+    return rep.group_id != 0;
+  }
+  void close() { push(END_REPORT); }
+  void destroy() { delete[] slots; }
+};
+
+// Очередь SPSC на каждую группу (treasure -q): один писатель — группа, один читатель —
+// Сильвер, общий мьютекс и sem_post на каждый доклад не нужны. Сильвер обходит очереди
+// по кругу; когда все пусты — засыпает на eventfd. Будит его группа, только если он
+// действительно спит (флаг sleeping), поэтому под нагрузкой системных вызовов на доклад нет.
+struct SpscSync {
+  static constexpr const char *name = "spsc";
+  static constexpr unsigned CAPACITY = 64; // степень двойки; докладов в полёте у группы немного
+
+  struct Queue {
+    alignas(64) unsigned head = 0; // пишет только Сильвер
+    unsigned tail_cache = 0;       // его копия tail
+    alignas(64) unsigned tail = 0; // пишет только группа
+    unsigned head_cache = 0;       // её копия head
+    Report items[CAPACITY];
+  };
+  Queue *queues = nullptr;
+  int groups = 0;
+  int next_queue = 0; // с какой группы продолжать обход
+  int efd = -1;
+  alignas(64) int sleeping = 0;
+  int done = 0;
+  unsigned long long wakeups = 0; // записей в eventfd за прогон
+
+  void init(int num_groups, int) {
+    groups = num_groups;
+    queues = new Queue[groups];
+    next_queue = 0;
+    efd = eventfd(0, EFD_CLOEXEC);
+    sleeping = done = 0;
+    wakeups = 0;
+  }
+
+  static bool try_push(Queue &q, const Report &rep) {
+    unsigned t = q.tail;
+    if (t - q.head_cache == CAPACITY) {
+      q.head_cache = __atomic_load_n(&q.head, __ATOMIC_ACQUIRE);
+      if (t - q.head_cache == CAPACITY)
+        return false;
+    }
+    q.items[t % CAPACITY] = rep;
+    __atomic_store_n(&q.tail, t + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  static bool try_pop(Queue &q, Report &rep) {
+    unsigned h = q.head;
+    if (h == q.tail_cache) {
+      q.tail_cache = __atomic_load_n(&q.tail, __ATOMIC_ACQUIRE);
+      if (h == q.tail_cache)
+        return false;
+    }
+    rep = q.items[h % CAPACITY];
+    __atomic_store_n(&q.head, h + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  bool any() {
+    for (int i = 0; i < groups; i++)
+      if (__atomic_load_n(&queues[i].tail, __ATOMIC_ACQUIRE) != queues[i].head)
+        return true;
+    return false;
+  }
+
+  // Вызывается группой после публикации: будит Сильвера, только если он уснул.
+  // Барьер в паре с барьером в pop: либо Сильвер увидит доклад при
+  // повторной проверке, либо группа увидит флаг сна.
+  void wake() {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sleeping, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&sleeping, 0, __ATOMIC_ACQ_REL)) {
+      uint64_t one = 1;
+      if (write(efd, &one, sizeof(one)) == (ssize_t)sizeof(one))
+        __atomic_add_fetch(&wakeups, 1, __ATOMIC_RELAXED);
+    }
+  }
+
+  // Своя очередь: без мьютекса и без системного вызова, пока Сильвер не спит
+  void push(const Report &rep) {
+    Queue &q = queues[rep.group_id - 1];
+    while (!try_push(q, rep)) {
+      wake();
+      sched_yield();
+    }
+    wake();
+  }
+
+  bool pop(Report &rep) {
+    for (;;) {
+      // По кругу: по одному докладу из очереди, следующую проверку — со следующей группы
+      for (int k = 0; k < groups; k++) {
+        int q = (next_queue + k) % groups;
+        if (try_pop(queues[q], rep)) {
+          next_queue = (q + 1) % groups;
+          return true;
+        }
+      }
+      // Группа могла положить последний доклад между обходом и чтением флага.
+      // После acquire на done все её push видны, так что хватает ещё одной проверки.
+      if (__atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+        if (!any())
+          return false;
+        continue;
+      }
+      // Засыпаем: флаг, барьер, повторная проверка (см. wake)
+      uint64_t t_wait = trace_begin();
+      __atomic_store_n(&sleeping, 1, __ATOMIC_RELAXED);
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      if (any() || __atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&sleeping, 0, __ATOMIC_RELAXED);
+      } else {
+        uint64_t v;
+        if (read(efd, &v, sizeof(v)) == -1 && errno != EINTR)
+          perror("read eventfd");
+      }
+      trace_end("wait", t_wait);
+    }
+  }
+
+  // Сильвер мог уснуть до последнего доклада (например, после Ctrl+C)
+  void close() {
+    __atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+    uint64_t one = 1;
+    if (write(efd, &one, sizeof(one)) == -1)
+      perror("write eventfd");
+  }
+
+  void destroy() {
+    ::close(efd);
+    efd = -1;
+    delete[] queues;
+    queues = nullptr;
+  }
+};
+
+// ---------------- Экспедиция ----------------
+
+// Обработка доклада и итог Сильвера: у каждой программы свои (вывод, архив, проверки)
+void silver_report(const Report &rep, int processed, int &found_total);
+void silver_finish(int found_total);
+
+// Потоки групп и Сильвера над политикой Sync. Участки — из section_map (заводит программа),
+// NUM_GROUPS групп, NUM_SECTIONS участков, зерно g_seed.
+template <class Sync> struct Expedition {
+  Sync sync;
+
+  struct GroupArg {
+    Expedition *exp;
+    int group_id;
+  };
+
+  static void *group_thread(void *arg) {
+    GroupArg *ga = (GroupArg *)arg;
+    Expedition &exp = *ga->exp;
+    int group_id = ga->group_id;
+    trace_thread("Группа " + std::to_string(group_id));
+    SearchDraws draws;
+    draws.seed(g_seed, group_id);
+
+    while (!g_terminate) {
+      // Берём участок: CAS по карте, без общего мьютекса
+      uint64_t t_claim = trace_begin();
+      int section_id = section_claim(section_map, NUM_SECTIONS, &next_section);
+      trace_end("claim", t_claim, "section", section_id);
+      if (section_id == -1)
+        break;
+
+      log_event("[Группа %d] Вышла на участок %d", group_id, section_id);
+
+      // Симуляция поиска (в бенчмарке поиска нет: меряется только доставка докладов)
+      uint64_t t_search = trace_begin();
+      int t = 0, found = 0;
+      if (!g_bench) {
+        // время поиска и находка — из своего генератора группы, без общего замка
+        draws.next(t, found);
+        usleep(t * 1000);
+      }
+      trace_end("search", t_search, "section", section_id);
+      section_done(section_map, section_id);
+
+      // Сохраняем доклад
+      uint64_t t_enq = trace_begin();
+      exp.sync.push({group_id, section_id, found, t});
+      trace_end("enqueue", t_enq, "section", section_id);
+    }
+
+    log_event("[Группа %d] завершила работу.", group_id);
+    return nullptr;
+  }
+
+  static void *silver_thread(void *arg) {
+    Expedition &exp = *(Expedition *)arg;
+    trace_thread("Сильвер");
+    int processed = 0;
+    int found_total = 0;
+    Report rep;
+    while (processed < NUM_SECTIONS) {
+      // dequeue включает ожидание (вложенный интервал wait, если политика спала)
+      uint64_t t_deq = trace_begin();
+      if (!exp.sync.pop(rep))
+        break; // группы вышли раньше (Ctrl+C), очередь разобрана
+      processed++;
+      trace_end("dequeue", t_deq, "section", rep.section_id);
+      silver_report(rep, processed, found_total);
+    }
+    silver_finish(found_total);
+    return nullptr;
+  }
+
+  void run() {
+    sync.init(NUM_GROUPS, NUM_SECTIONS + 1); // + метка конца
+
+    // Создаём потоки групп
+    std::vector<pthread_t> threads(NUM_GROUPS);
+    std::vector<GroupArg> args(NUM_GROUPS);
+    for (int i = 0; i < NUM_GROUPS; i++) {
+      args[i] = {this, i + 1};
+      pthread_create(&threads[i], nullptr, group_thread, &args[i]);
+    }
+
+    // Управляющий поток (Сильвер)
+    pthread_t silver;
+    pthread_create(&silver, nullptr, silver_thread, this);
+
+    // Ждём завершения всех групп; докладов больше не будет
+    for (int i = 0; i < NUM_GROUPS; i++)
+      pthread_join(threads[i], nullptr);
+    sync.close();
+
+    pthread_join(silver, nullptr);
+    sync.destroy();
+  }
+};
@@ -0,0 +1,219 @@
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+
+#include "expedition.h"
+
+using namespace std;
+
+// Матрица политик синхронизации над общей экспедицией из expedition.h.
+// treasure.cpp и alter_primitives.cpp инстанцируют Expedition<Sync> своей политикой
+// (MutexSemSync/SpscSync и LockFreeSync); здесь — все политики подряд, по одной
+// специализации на политику, и проверка, что каждый участок доложен ровно один раз.
+
+struct RunStats {
+  double seconds;
+  long context_switches;
+  bool exact; // каждый участок доложен ровно один раз
+};
+
+vector<int> seen; // сколько раз доложен каждый участок
+
+void silver_report(const Report &rep, int, int &found_total) {
+  if (rep.section_id >= 0 && rep.section_id < NUM_SECTIONS)
+    seen[rep.section_id]++;
+  if (rep.found)
+    found_total++;
+  log_event("[Сильвер] Доклад от группы %d: участок %d, время %d ms, %s",
+            rep.group_id, rep.section_id, rep.search_time,
+            rep.found ? "СОКРОВИЩЕ НАЙДЕНО!" : "пусто");
+}
+
+void silver_finish(int found_total) {
+  log_msg("[Сильвер] Работа завершена. Найдено кладов: %d", found_total);
+}
+
+// Один прогон политики Sync
+template <class Sync> RunStats run_policy(int groups, int sections) {
+  NUM_GROUPS = groups;
+  NUM_SECTIONS = sections;
+  next_section = 0;
+  section_map = new uint64_t[section_words(sections)]();
+  seen.assign(sections, 0);
+
+  long cs0 = context_switches();
+  uint64_t t0 = mono_ns();
+  Expedition<Sync> exp;
+  exp.run();
+
+  RunStats st;
+  st.seconds = (mono_ns() - t0) / 1e9;
+  st.context_switches = context_switches() - cs0;
+  st.exact = true;
+  for (int i = 0; i < sections && !g_terminate; i++)
+    if (seen[i] != 1)
+      st.exact = false;
+  delete[] section_map;
+  section_map = nullptr;
+  return st;
+}
+
+// Таблица политик: имя -> специализация
+struct PolicyEntry {
+  const char *name;
+  RunStats (*run)(int, int);
+};
+
+const PolicyEntry POLICIES[] = {
+    {MutexSemSync::name, run_policy<MutexSemSync>},
+    {CondVarSync::name, run_policy<CondVarSync>},
+    {LockFreeSync::name, run_policy<LockFreeSync>},
+    {FutexSync::name, run_policy<FutexSync>},
+    {SpinSync::name, run_policy<SpinSync>},
+    {SpscSync::name, run_policy<SpscSync>},
+};
+
+vector<int> parse_list(const string &s) {
+  vector<int> v;
+  size_t pos = 0;
+  while (pos < s.size()) {
+    size_t comma = s.find(',', pos);
+    if (comma == string::npos)
+      comma = s.size();
+    v.push_back(stoi(s.substr(pos, comma - pos)));
+    pos = comma + 1;
+  }
+  return v;
+}
+
+// Матрица: все политики (или выбранная) x число групп x число участков.
+// Каждая клетка — лучший из repeats прогонов.
+int bench_matrix(const vector<const PolicyEntry *> &policies,
+                 const vector<int> &groups_list,
+                 const vector<int> &sections_list, int repeats) {
+  g_bench = true;
+  int status = 0;
+  // заголовок выровнен вручную: printf считает ширину в байтах, а не в буквах
+  printf("%s\n", "   политика   групп  участков       мс      докл./с    перекл.");
+  for (const PolicyEntry *p : policies) {
+    for (int sections : sections_list) {
+      for (int groups : groups_list) {
+        RunStats best{};
+        for (int r = 0; r < repeats; r++) {
+          RunStats st = p->run(groups, sections);
+          if (!st.exact) {
+            cerr << "ОШИБКА: " << p->name << ", групп " << groups
+                 << ", участков " << sections
+                 << ": не каждый участок доложен ровно один раз" << endl;
+            status = 1;
+          }
+          if (r == 0 || st.seconds < best.seconds)
+            best = st;
+        }
+        printf("%11s %7d %9d %8.2f %12.0f %10ld\n", p->name, groups, sections,
+               best.seconds * 1000, sections / best.seconds,
+               best.context_switches);
+        fflush(stdout);
+      }
+    }
+  }
+  g_bench = false;
+  return status;
+}
+
+int main(int argc, char *argv[]) {
+  int num_groups = 5, num_sections = 20;
+  string policy = "mutex+sem";
+  bool bench = false;
+  vector<int> groups_list = {1, 2, 8, 32, 128};
+  vector<int> sections_list = {10000, 100000};
+  int repeats = 3;
+
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "-g" || arg == "--groups") {
+      groups_list = parse_list(argv[++i]);
+      num_groups = groups_list[0];
+    } else if (arg == "-s" || arg == "--sections") {
+      sections_list = parse_list(argv[++i]);
+      num_sections = sections_list[0];
+    } else if (arg == "-p" || arg == "--policy") {
+      policy = argv[++i];
+    } else if (arg == "-b" || arg == "--bench") {
+      bench = true;
+    } else if (arg == "-r" || arg == "--repeats") {
+      repeats = stoi(argv[++i]);
+    } else if (arg == "--seed") {
+      g_seed = stoull(argv[++i]);
+    } else if (arg == "-o" || arg == "--output-file") {
+      outFile.open(argv[++i]);
+      if (!outFile) {
+        cerr << "Не удалось открыть файл для вывода\n";
+        return 1;
+      }
+    } else {
+      cerr << "Неизвестный ключ: " << arg << endl;
+      return 1;
+    }
+  }
+
+  vector<const PolicyEntry *> selected;
+  for (const PolicyEntry &p : POLICIES)
+    if (policy == "all" || policy == p.name)
+      selected.push_back(&p);
+  if (selected.empty()) {
+    cerr << "Неизвестная политика: " << policy
+         << " (mutex+sem, condvar, lockfree, futex, spin, spsc, all)" << endl;
+    return 1;
+  }
+
+  if (bench) {
+    // в бенчмарке по умолчанию все политики
+    bool explicit_policy = false;
+    for (int i = 1; i < argc; ++i)
+      if (string(argv[i]) == "-p" || string(argv[i]) == "--policy")
+        explicit_policy = true;
+    if (!explicit_policy) {
+      selected.clear();
+      for (const PolicyEntry &p : POLICIES)
+        selected.push_back(&p);
+    }
+    return bench_matrix(selected, groups_list, sections_list, repeats);
+  }
+
+  if (num_groups <= 0 || num_sections <= 0 || num_groups >= num_sections) {
+    cerr << "Ошибка: число групп должно быть > 0 и < числа участков." << endl;
+    return 1;
+  }
+
+  signal(SIGTERM, sigint_handler);
+  signal(SIGINT, sigint_handler);
+
+  // Зерно запуска: у всех политик одно, группы повторяют те же поиски
+  if (g_seed == 0)
+    g_seed = (uint64_t)time(nullptr);
+
+  log_start();
+  log_msg("Зерно запуска: %llu (повтор: --seed %llu)",
+          (unsigned long long)g_seed, (unsigned long long)g_seed);
+  int status = 0;
+  for (const PolicyEntry *p : selected) {
+    log_msg("=== Политика %s ===", p->name);
+    RunStats st = p->run(num_groups, num_sections);
+    if (!g_terminate && !st.exact) {
+      cerr << "ОШИБКА: не каждый участок доложен ровно один раз" << endl;
+      status = 1;
+    }
+  }
+  log_stop();
+
+  if (outFile) {
+    outFile.close();
+  }
+  return status;
+}
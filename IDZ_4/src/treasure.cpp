@@ -1,182 +1,1136 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <ctime>
+#include <deque>
 #include <fstream>
 #include <iostream>
+#include <queue>
 #include <vector>
 
-#include <ostream>
 #include <pthread.h>
 #include <semaphore.h>
 #include <signal.h>
 #include <unistd.h>
 
+#include "../../IDZ_3/src/Grade4/archive_format.h"
+#include "expedition.h"
+
 using namespace std;
 
-// Параметры генерации случайных чисел
-constexpr int MIN_GROUP_DELAY = 200;
-constexpr int MAX_GROUP_DELAY = 1500;
+// Параметры запуска, доклад, трасса, логгер, генератор групп и сама экспедиция
+// (потоки групп и Сильвера над политикой доставки докладов) — в expedition.h,
+// общем с alter_primitives.cpp и sync_policies.cpp. Основная версия доставляет
+// доклады политикой MutexSemSync, режим очередей (-q/--spsc) — SpscSync.
+bool g_spsc = false;
+bool g_coro = false; // группы — сопрограммы на пуле потоков (-c)
+unsigned long long silver_wakeups = 0; // -q: записей в eventfd за прогон
+
+// Архив отчётов (-a). Формат и запись — в IDZ_3/src/Grade4/archive_format.h,
+// общем с manager_named и archive_tool.
+ArchiveWriter archive;
+
+bool g_simulate = false; // -S: дискретно-событийная симуляция вместо потоков
+
+// Статистика прогона по потоку докладов: одинаково считается в реальном прогоне
+// и в симуляции (-S), по ней их и сравнивает --check-sim
+struct ExpeditionStats {
+  long long reports = 0;
+  long long found = 0;
+  double sum_search = 0, sum_search2 = 0; // мс
+  double makespan_s = 0; // от старта до последнего доклада
+};
+ExpeditionStats g_stats;
+uint64_t g_run_start_ns = 0;
+
+// Обработка одного доклада Сильвером (общая для потока, сопрограммы и симуляции)
+void silver_report(const Report &rep, int processed, int &found_total) {
+  // сводка по карте каждые 10% (на коротких прогонах — только в конце)
+  int progress_step = NUM_SECTIONS >= 100 ? NUM_SECTIONS / 10 : NUM_SECTIONS;
 
-// Параметры запуска
-int NUM_SECTIONS = 20; // Кол-во участков
-int NUM_GROUPS = 5;    // Кол-во поисковых групп
-double TREASURE_PROB = 0.05;
-std::ofstream outFile;
+  g_stats.reports++;
+  g_stats.found += rep.found;
+  g_stats.sum_search += rep.search_time;
+  g_stats.sum_search2 += (double)rep.search_time * rep.search_time;
+  if (!g_simulate)
+    g_stats.makespan_s = (mono_ns() - g_run_start_ns) / 1e9;
+  if (rep.found)
+    found_total++;
+  archive_append(archive, rep.section_id, rep.group_id, getpid(),
+                 rep.search_time, rep.found);
 
-// Глобальные данные
-int next_section = 0;
-int *section_taken = nullptr;
+  log_event("[Сильвер] Доклад от группы %d: участок %d, время %d ms, %s",
+            rep.group_id, rep.section_id, rep.search_time,
+            rep.found ? "СОКРОВИЩЕ НАЙДЕНО!" : "пусто");
 
-// Мьютексы
-pthread_mutex_t mutex_alloc;
-pthread_mutex_t mutex_reports;
+  if (processed % progress_step == 0 && processed < NUM_SECTIONS) {
+    long long claimed, done;
+    section_count(section_map, NUM_SECTIONS, claimed, done);
+    log_msg("[Сильвер] Прогресс: обследовано %lld из %d, в работе %lld", done,
+            NUM_SECTIONS, claimed);
+  }
+}
+
+void silver_finish(int found_total) {
+  long long claimed, done;
+  section_count(section_map, NUM_SECTIONS, claimed, done);
+  log_msg("[Сильвер] Работа завершена. Найдено кладов: %d, обследовано "
+          "участков: %lld из %d",
+          found_total, done, NUM_SECTIONS);
+}
 
-// Семафор для докладов
-sem_t sem_report;
+// Потоковый режим (--stream [C]): память не зависит от числа участков.
+// Участки выдаются 64-битным счётчиком по порядку, без карты и без массива докладов.
+// Доклады идут через кольцо на C мест под мьютексом и двумя семафорами: группа ждёт
+// место (sem_space), если Сильвер отстал, — обратное давление вместо роста памяти.
+// Сильвер ведёт только суммы (g_stats), так что 10^10 участков занимают столько же,
+// сколько 10^3.
+bool g_stream = false;
+bool g_no_search = false;        // --no-search: время разыгрывается, но без usleep
+long long g_stream_sections = 0; // участков в потоковом режиме (может быть > INT_MAX)
+int g_stream_capacity = 1024;
 
-// Структура доклада
-struct Report {
+struct StreamReport {
+  long long section_id;
   int group_id;
-  int section_id;
   int found;
   int search_time;
 };
 
-// Массив докладов
-Report *reports = nullptr;
-int reports_count = 0;
+struct StreamRing {
+  StreamReport *cells = nullptr;
+  int capacity = 0;
+  long long head = 0, tail = 0; // под mutex
+  pthread_mutex_t mutex;
+  sem_t items; // доклады в кольце
+  sem_t space; // свободные места
+};
+StreamRing stream_ring;
+long long stream_next = 0;              // следующий участок
+int stream_groups_done = 0;             // все группы вышли (после Ctrl+C кольцо может быть пустым)
+unsigned long long stream_stalls = 0;   // сколько раз группа ждала место в кольце
 
-// Вывод сообщений
-void log_msg(const string &msg) {
-  cout << msg << endl;
-  if (outFile) {
-    outFile << msg << "\n";
+void sem_wait_nointr(sem_t *sem) {
+  while (sem_wait(sem) == -1 && errno == EINTR) {
   }
 }
 
-// Обработка сигналов
-static volatile sig_atomic_t g_terminate = 0;
-void sigint_handler(int) { g_terminate = 1; }
-
-// Поток группы
-void *group_thread(void *arg) {
+void *stream_group_thread(void *arg) {
   int group_id = (int)(long)arg;
-
-  int section_id = -1;
+  SearchDraws draws;
+  draws.seed(g_seed, group_id);
+  StreamRing &ring = stream_ring;
   while (!g_terminate) {
-    // Выдаём участок
-    pthread_mutex_lock(&mutex_alloc);
-    if (next_section >= NUM_SECTIONS) {
-      pthread_mutex_unlock(&mutex_alloc);
+    long long section_id = __atomic_fetch_add(&stream_next, 1, __ATOMIC_RELAXED);
+    if (section_id >= g_stream_sections)
       break;
+    log_event("[Группа %d] Вышла на участок %lld", group_id, section_id);
+
+    int t, found;
+    draws.next(t, found);
+    if (!g_no_search)
+      usleep(t * 1000);
+
+    // Обратное давление: кольцо полно — ждём, пока Сильвер разберёт доклад
+    if (sem_trywait(&ring.space) == -1) {
+      __atomic_fetch_add(&stream_stalls, 1, __ATOMIC_RELAXED);
+      sem_wait_nointr(&ring.space);
     }
-    section_id = next_section;
-    next_section++;
-    section_taken[section_id] = 1;
+    if (g_terminate)
+      break;
+    pthread_mutex_lock(&ring.mutex);
+    ring.cells[ring.tail % ring.capacity] = {section_id, group_id, found, t};
+    ring.tail++;
+    pthread_mutex_unlock(&ring.mutex);
+    sem_post(&ring.items);
+  }
+  log_event("[Группа %d] завершила работу.", group_id);
+  return nullptr;
+}
 
-    pthread_mutex_unlock(&mutex_alloc);
+void *stream_silver(void *) {
+  StreamRing &ring = stream_ring;
+  long long total = g_stream_sections;
+  long long progress_step = total >= 100 ? total / 10 : total;
+  long long processed = 0;
+  while (processed < total && !g_terminate) {
+    sem_wait_nointr(&ring.items);
+    pthread_mutex_lock(&ring.mutex);
+    if (ring.head == ring.tail) { // разбудили после выхода групп
+      pthread_mutex_unlock(&ring.mutex);
+      if (__atomic_load_n(&stream_groups_done, __ATOMIC_ACQUIRE))
+        break;
+      continue;
+    }
+    StreamReport rep = ring.cells[ring.head % ring.capacity];
+    ring.head++;
+    long long in_ring = ring.tail - ring.head;
+    pthread_mutex_unlock(&ring.mutex);
+    sem_post(&ring.space);
+    processed++;
 
-    log_msg("[Группа " + to_string(group_id) + "] Вышла на участок " +
-            to_string(section_id));
+    g_stats.reports++;
+    g_stats.found += rep.found;
+    g_stats.sum_search += rep.search_time;
+    g_stats.sum_search2 += (double)rep.search_time * rep.search_time;
+    log_event("[Сильвер] Доклад от группы %d: участок %lld, время %d ms, %s",
+              rep.group_id, rep.section_id, rep.search_time,
+              rep.found ? "СОКРОВИЩЕ НАЙДЕНО!" : "пусто");
+    if (processed % progress_step == 0 && processed < total) {
+      long long issued = min(__atomic_load_n(&stream_next, __ATOMIC_RELAXED), total);
+      log_msg("[Сильвер] Прогресс: обследовано %lld из %lld, в кольце %lld, "
+              "в работе %lld",
+              processed, total, in_ring, issued - processed - in_ring);
+    }
+  }
+  g_stats.makespan_s = (mono_ns() - g_run_start_ns) / 1e9;
+  // Группы, ждущие место после Ctrl+C, больше не дождутся Сильвера
+  for (int i = 0; i < NUM_GROUPS; i++)
+    sem_post(&ring.space);
+  return nullptr;
+}
+
+// Пиковая память процесса (ru_maxrss, КБ)
+long peak_rss_kb() {
+  rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_maxrss;
+}
 
-    // Симуляция поиска
-    int t = rand() % (MAX_GROUP_DELAY - MIN_GROUP_DELAY) + MIN_GROUP_DELAY;
-    usleep(t * 1000);
+void run_stream() {
+  StreamRing &ring = stream_ring;
+  ring.capacity = g_stream_capacity;
+  ring.cells = new StreamReport[ring.capacity];
+  ring.head = ring.tail = 0;
+  pthread_mutex_init(&ring.mutex, nullptr);
+  sem_init(&ring.items, 0, 0);
+  sem_init(&ring.space, 0, ring.capacity);
+  stream_next = 0;
+  stream_groups_done = 0;
+  stream_stalls = 0;
 
-    // Найдено сокровище?
-    double r = (double)rand() / RAND_MAX;
-    int found = (r < TREASURE_PROB);
+  pthread_t *threads = new pthread_t[NUM_GROUPS];
+  for (int i = 0; i < NUM_GROUPS; i++)
+    pthread_create(&threads[i], nullptr, stream_group_thread, (void *)(long)(i + 1));
+  pthread_t silver_thread;
+  pthread_create(&silver_thread, nullptr, stream_silver, nullptr);
 
-    // Сохраняем доклад
-    pthread_mutex_lock(&mutex_reports);
+  for (int i = 0; i < NUM_GROUPS; i++)
+    pthread_join(threads[i], nullptr);
+  __atomic_store_n(&stream_groups_done, 1, __ATOMIC_RELEASE);
+  sem_post(&ring.items);
+  pthread_join(silver_thread, nullptr);
 
-    reports[reports_count].group_id = group_id;
-    reports[reports_count].section_id = section_id;
-    reports[reports_count].found = found;
-    reports[reports_count].search_time = t;
-    reports_count++;
+  long long n = g_stats.reports;
+  double mean = n ? g_stats.sum_search / n : 0;
+  double sd = n ? sqrt(max(0.0, g_stats.sum_search2 / n - mean * mean)) : 0;
+  log_msg("[Сильвер] Работа завершена. Найдено кладов: %lld, обследовано "
+          "участков: %lld из %lld",
+          g_stats.found, n, g_stream_sections);
+  log_msg("Поток: кольцо %d, ожиданий места %llu, поиск %.1f ± %.1f мс, "
+          "пиковая память (RSS) %.1f МБ",
+          ring.capacity, stream_stalls, mean, sd, peak_rss_kb() / 1024.0);
 
-    pthread_mutex_unlock(&mutex_reports);
+  sem_destroy(&ring.space);
+  sem_destroy(&ring.items);
+  pthread_mutex_destroy(&ring.mutex);
+  delete[] ring.cells;
+  ring.cells = nullptr;
+  delete[] threads;
+}
 
-    sem_post(&sem_report);
+// Дискретно-событийная симуляция (-S)
+// Те же группы, карта участков и обработка докладов Сильвером, но время виртуальное:
+// поиск — не usleep, а событие «группа вернулась» в очереди с приоритетом по времени.
+// Один поток разбирает события по порядку; при равном времени — по порядку постановки,
+// поэтому прогон с тем же зерном повторяется до доклада.
+struct SimEvent {
+  uint64_t t_ms;
+  uint64_t seq;
+  int group_id;
+  int section_id;
+  int search_ms;
+  int found;
+  bool operator>(const SimEvent &o) const {
+    return t_ms != o.t_ms ? t_ms > o.t_ms : seq > o.seq;
   }
+};
+
+void run_simulation(uint64_t seed) {
+  vector<SearchDraws> draws(NUM_GROUPS + 1);
+  for (int g = 1; g <= NUM_GROUPS; g++)
+    draws[g].seed(seed, g);
+
+  priority_queue<SimEvent, vector<SimEvent>, greater<SimEvent>> events;
+  uint64_t seq = 0;
+  // Группа берёт участок и уходит на поиск: событие возвращения через search_ms
+  auto dispatch = [&](int group_id, uint64_t now) {
+    if (g_terminate)
+      return false;
+    int section_id = section_claim(section_map, NUM_SECTIONS, &next_section);
+    if (section_id == -1)
+      return false;
+    log_event("[Группа %d] Вышла на участок %d", group_id, section_id);
+    int t, found;
+    draws[group_id].next(t, found);
+    events.push({now + (uint64_t)t, seq++, group_id, section_id, t, found});
+    return true;
+  };
+
+  for (int g = 1; g <= NUM_GROUPS; g++)
+    if (!dispatch(g, 0))
+      log_event("[Группа %d] завершила работу.", g);
+
+  int processed = 0, found_total = 0;
+  uint64_t now = 0;
+  while (!events.empty()) {
+    SimEvent ev = events.top();
+    events.pop();
+    now = ev.t_ms;
+
+    section_done(section_map, ev.section_id);
+    processed++;
+    silver_report({ev.group_id, ev.section_id, ev.found, ev.search_ms}, processed,
+                  found_total);
+
+    if (!dispatch(ev.group_id, now))
+      log_event("[Группа %d] завершила работу.", ev.group_id);
+  }
+  silver_finish(found_total);
+  g_stats.makespan_s = now / 1000.0;
+}
+
+// Та же симуляция без карты, вывода и глобального состояния — для серий (-M).
+// Один поток разбирает события, участки выдаются по порядку, как section_claim
+// в run_simulation, поэтому при том же зерне итог совпадает с -S.
+ExpeditionStats simulate_expedition(uint64_t seed) {
+  vector<SearchDraws> draws(NUM_GROUPS + 1);
+  for (int g = 1; g <= NUM_GROUPS; g++)
+    draws[g].seed(seed, g);
 
-  log_msg("[Группа " + to_string(group_id) + "] завершила работу.");
+  ExpeditionStats st;
+  priority_queue<SimEvent, vector<SimEvent>, greater<SimEvent>> events;
+  uint64_t seq = 0;
+  int next = 0;
+  auto dispatch = [&](int group_id, uint64_t now) {
+    if (next >= NUM_SECTIONS)
+      return;
+    int t, found;
+    draws[group_id].next(t, found);
+    events.push({now + (uint64_t)t, seq++, group_id, next++, t, found});
+  };
+
+  for (int g = 1; g <= NUM_GROUPS; g++)
+    dispatch(g, 0);
+  uint64_t now = 0;
+  while (!events.empty()) {
+    SimEvent ev = events.top();
+    events.pop();
+    now = ev.t_ms;
+    st.reports++;
+    st.found += ev.found;
+    st.sum_search += ev.search_ms;
+    st.sum_search2 += (double)ev.search_ms * ev.search_ms;
+    dispatch(ev.group_id, now);
+  }
+  st.makespan_s = now / 1000.0;
+  return st;
+}
+
+#if defined(__cpp_impl_coroutine)
+// Режим сопрограмм (-c, нужен -std=c++20)
+// Группа — сопрограмма, а не поток: кадр в сотни байт вместо стека потока,
+// поиск — co_await таймера вместо usleep. Сопрограммы выполняет пул из
+// co_pool_size потоков (по числу ядер). Готовые к запуску лежат в очереди co_ready
+// под мьютексом пула, спящие — в колесе таймеров (ниже).
+// Сильвер — тоже сопрограмма, доклады получает через канал co_channel.
+struct CoTask {
+  struct promise_type {
+    CoTask get_return_object() {
+      return {coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    suspend_always initial_suspend() noexcept { return {}; }
+    suspend_never final_suspend() noexcept { return {}; } // кадр удаляется сам
+    void return_void() {}
+    void unhandled_exception() { terminate(); }
+  };
+  coroutine_handle<promise_type> handle;
+};
+
+int co_pool_size = 0;
+pthread_mutex_t co_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t co_cond;
+deque<coroutine_handle<>> co_ready;
+bool co_stop = false;
+int co_groups_alive = 0;
+
+void co_schedule(coroutine_handle<> h) {
+  pthread_mutex_lock(&co_mutex);
+  co_ready.push_back(h);
+  pthread_cond_signal(&co_cond);
+  pthread_mutex_unlock(&co_mutex);
+}
+
+// Иерархическое колесо таймеров
+// WHEEL_LEVELS уровней по WHEEL_SLOTS слотов, тик TIMER_TICK_NS (1 мс): уровень 0 покрывает
+// 64 мс, уровень 1 — 4 с, уровень 3 — 4.6 ч. Таймер кладётся в слот по битам своего тика;
+// когда младшие уровни проходят полный круг, слот старшего уровня раскладывается вниз.
+// Вставка и срабатывание — O(1), сколько бы таймеров ни ждало.
+// Колесо ведёт один поток timer_thread. Сопрограммы регистрируют таймер без блокировки:
+// узел (он лежит в кадре сопрограммы) кладётся в стек timer_inbox, поток таймеров
+// раз в тик забирает стек целиком. Сработавшие за тик таймеры уходят в co_ready
+// одной пачкой под одним захватом co_mutex.
+constexpr int WHEEL_BITS = 6;
+constexpr int WHEEL_SLOTS = 1 << WHEEL_BITS;
+constexpr int WHEEL_LEVELS = 4;
+constexpr uint64_t TIMER_TICK_NS = 1000000; // 1 мс
+
+struct TimerNode {
+  TimerNode *next;
+  uint64_t due_ns;   // когда должен сработать
+  uint64_t due_tick; // первый тик не раньше due_ns
+  coroutine_handle<> handle;
+};
+
+// Гистограмма с равными корзинами: среднее, максимум и перцентили без хранения выборки
+struct TimerHist {
+  static constexpr int BUCKETS = 1000;
+  uint64_t width_ns;
+  uint64_t counts[BUCKETS + 1] = {}; // последняя — всё, что дальше
+  uint64_t n = 0, sum = 0, max = 0;
+
+  void add(uint64_t v) {
+    uint64_t b = v / width_ns;
+    counts[b < BUCKETS ? b : BUCKETS]++;
+    n++;
+    sum += v;
+    if (v > max)
+      max = v;
+  }
+  uint64_t percentile(double p) const {
+    uint64_t need = (uint64_t)(p * n), acc = 0;
+    for (int b = 0; b <= BUCKETS; b++) {
+      acc += counts[b];
+      if (acc > need)
+        return b < BUCKETS ? (b + 1) * width_ns : max;
+    }
+    return max;
+  }
+};
+
+struct TimerWheel {
+  TimerNode *slots[WHEEL_LEVELS][WHEEL_SLOTS] = {};
+  uint64_t start_ns = 0;
+  uint64_t now_tick = 0;          // обработаны все тики до него включительно
+  TimerNode *inbox = nullptr;     // стек новых таймеров (Трайбер), пишут сопрограммы
+  int stop = 0;
+  // статистика
+  uint64_t fired = 0, ticks = 0, wakeups = 0, cascaded = 0;
+  uint64_t max_batch = 0;
+  TimerHist tick_cost{10000};     // обработка за пробуждение, корзина 10 мкс
+  TimerHist skew{100000};         // опоздание срабатывания, корзина 0.1 мс
+};
+
+TimerWheel *timer_wheel = nullptr;
+
+void timer_place(TimerWheel &w, TimerNode *n, vector<TimerNode *> &batch) {
+  if (n->due_tick <= w.now_tick) {
+    batch.push_back(n);
+    return;
+  }
+  uint64_t delta = n->due_tick - w.now_tick;
+  int level = 0;
+  while (level < WHEEL_LEVELS - 1 &&
+         delta >= (1ULL << (WHEEL_BITS * (level + 1))))
+    level++;
+  uint64_t tick = n->due_tick;
+  uint64_t horizon = 1ULL << (WHEEL_BITS * WHEEL_LEVELS);
+  if (delta >= horizon) // дальше последнего уровня: ждёт полный круг и раскладывается снова
+    tick = w.now_tick + horizon - 1;
+  TimerNode *&slot =
+      w.slots[level][(tick >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)];
+  n->next = slot;
+  slot = n;
+}
+
+// Один тик: раскладка старших уровней на границе круга, затем слот уровня 0
+void timer_tick(TimerWheel &w, vector<TimerNode *> &batch) {
+  w.now_tick++;
+  w.ticks++;
+  for (int level = 1; level < WHEEL_LEVELS; level++) {
+    uint64_t mask = (1ULL << (WHEEL_BITS * level)) - 1;
+    if (w.now_tick & mask)
+      break;
+    TimerNode *&slot = w.slots[level][(w.now_tick >> (WHEEL_BITS * level)) &
+                                      (WHEEL_SLOTS - 1)];
+    TimerNode *n = slot;
+    slot = nullptr;
+    while (n) {
+      TimerNode *next = n->next;
+      timer_place(w, n, batch);
+      w.cascaded++;
+      n = next;
+    }
+  }
+  TimerNode *&slot = w.slots[0][w.now_tick & (WHEEL_SLOTS - 1)];
+  for (TimerNode *n = slot; n; n = n->next)
+    batch.push_back(n);
+  slot = nullptr;
+}
+
+void timer_add(TimerNode *n) {
+  TimerWheel &w = *timer_wheel;
+  n->due_tick = (n->due_ns - w.start_ns + TIMER_TICK_NS - 1) / TIMER_TICK_NS;
+  TimerNode *head = __atomic_load_n(&w.inbox, __ATOMIC_RELAXED);
+  do {
+    n->next = head;
+  } while (!__atomic_compare_exchange_n(&w.inbox, &head, n, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+void *timer_thread(void *) {
+  trace_thread("Таймеры");
+  TimerWheel &w = *timer_wheel;
+  vector<TimerNode *> batch;
+  vector<coroutine_handle<>> handles;
+  uint64_t next_ns = w.start_ns;
+  while (!__atomic_load_n(&w.stop, __ATOMIC_ACQUIRE)) {
+    next_ns += TIMER_TICK_NS;
+    timespec ts = {(time_t)(next_ns / 1000000000ULL),
+                   (long)(next_ns % 1000000000ULL)};
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+
+    uint64_t t0 = mono_ns();
+    uint64_t target = (t0 - w.start_ns) / TIMER_TICK_NS;
+    if (target > w.now_tick + 1)
+      next_ns = w.start_ns + target * TIMER_TICK_NS; // проспали тики — не догоняем сном
+
+    // Новые таймеры: забираем стек целиком и раскладываем
+    TimerNode *n = __atomic_exchange_n(&w.inbox, nullptr, __ATOMIC_ACQUIRE);
+    while (n) {
+      TimerNode *next = n->next;
+      timer_place(w, n, batch);
+      n = next;
+    }
+    while (w.now_tick < target)
+      timer_tick(w, batch);
+
+    w.wakeups++;
+    if (batch.empty()) {
+      w.tick_cost.add(mono_ns() - t0);
+      continue;
+    }
+    // После передачи в пул узел может исчезнуть вместе с кадром: сначала статистика
+    uint64_t fire_ns = mono_ns();
+    handles.clear();
+    for (TimerNode *b : batch) {
+      w.skew.add(fire_ns > b->due_ns ? fire_ns - b->due_ns : 0);
+      handles.push_back(b->handle);
+    }
+    w.fired += batch.size();
+    if (batch.size() > w.max_batch)
+      w.max_batch = batch.size();
+    batch.clear();
+
+    pthread_mutex_lock(&co_mutex);
+    for (coroutine_handle<> h : handles)
+      co_ready.push_back(h);
+    if (handles.size() == 1)
+      pthread_cond_signal(&co_cond);
+    else
+      pthread_cond_broadcast(&co_cond);
+    pthread_mutex_unlock(&co_mutex);
+    w.tick_cost.add(mono_ns() - t0);
+  }
   return nullptr;
 }
 
-// Поток Сильвера (главный)
-void *silver_manager(void *) {
+void timer_report(const TimerWheel &w) {
+  log_msg("[Таймеры] сработало %llu, тиков %llu, пробуждений %llu, раскладок "
+          "вниз %llu, самая большая пачка %llu",
+          (unsigned long long)w.fired, (unsigned long long)w.ticks,
+          (unsigned long long)w.wakeups, (unsigned long long)w.cascaded,
+          (unsigned long long)w.max_batch);
+  if (w.tick_cost.n)
+    log_msg("[Таймеры] обработка за пробуждение: сред. %.1f мкс, p99 %.1f мкс, "
+            "макс %.1f мкс",
+            w.tick_cost.sum / 1e3 / w.tick_cost.n,
+            w.tick_cost.percentile(0.99) / 1e3, w.tick_cost.max / 1e3);
+  if (w.skew.n)
+    log_msg("[Таймеры] опоздание срабатывания: сред. %.2f мс, p99 %.2f мс, "
+            "макс %.2f мс",
+            w.skew.sum / 1e6 / w.skew.n, w.skew.percentile(0.99) / 1e6,
+            w.skew.max / 1e6);
+}
+
+// co_await co_sleep_ms{t}: кадр уходит в колесо таймеров, поток пула свободен
+struct co_sleep_ms {
+  int ms;
+  TimerNode node{};
+  bool await_ready() const { return ms <= 0; }
+  void await_suspend(coroutine_handle<> h) {
+    node.due_ns = mono_ns() + (uint64_t)ms * 1000000ULL;
+    node.handle = h;
+    timer_add(&node);
+  }
+  void await_resume() const {}
+};
+
+// Канал докладов: писателей много, читатель один (Сильвер)
+struct ReportChannel {
+  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  deque<Report> items;
+  coroutine_handle<> waiter;
+
+  void send(const Report &rep) {
+    pthread_mutex_lock(&mutex);
+    items.push_back(rep);
+    coroutine_handle<> h = waiter;
+    waiter = nullptr;
+    pthread_mutex_unlock(&mutex);
+    if (h)
+      co_schedule(h);
+  }
+
+  struct RecvAwaiter {
+    ReportChannel &ch;
+    bool await_ready() const { return false; }
+    bool await_suspend(coroutine_handle<> h) {
+      // После unlock кадр может уже выполняться в другом потоке пула — его не трогаем
+      pthread_mutex_t *m = &ch.mutex;
+      pthread_mutex_lock(m);
+      if (!ch.items.empty()) {
+        pthread_mutex_unlock(m);
+        return false;
+      }
+      ch.waiter = h;
+      pthread_mutex_unlock(m);
+      return true;
+    }
+    Report await_resume() {
+      pthread_mutex_lock(&ch.mutex);
+      Report rep = ch.items.front();
+      ch.items.pop_front();
+      pthread_mutex_unlock(&ch.mutex);
+      return rep;
+    }
+  };
+  RecvAwaiter recv() { return {*this}; }
+};
+
+ReportChannel co_channel;
+
+CoTask group_coro(int group_id) {
+  // генератор в кадре сопрограммы: группа может продолжиться на любом потоке пула
+  SearchDraws draws;
+  draws.seed(g_seed, group_id);
+  while (!g_terminate) {
+    uint64_t t_claim = trace_begin();
+    int section_id = section_claim(section_map, NUM_SECTIONS, &next_section);
+    trace_end("claim", t_claim, "section", section_id);
+    if (section_id == -1)
+      break;
+
+    log_event("[Группа %d] Вышла на участок %d", group_id, section_id);
+
+    // Симуляция поиска: таймер вместо usleep
+    int t, found;
+    draws.next(t, found);
+    co_await co_sleep_ms{t};
+    section_done(section_map, section_id);
+
+    uint64_t t_enq = trace_begin();
+    co_channel.send({group_id, section_id, found, t});
+    trace_end("enqueue", t_enq, "section", section_id);
+  }
+
+  log_event("[Группа %d] завершила работу.", group_id);
+  // Последняя группа шлёт метку конца: Сильвер не ждёт докладов, которых не будет
+  if (__atomic_sub_fetch(&co_groups_alive, 1, __ATOMIC_ACQ_REL) == 0)
+    co_channel.send({0, -1, 0, 0});
+}
+
+CoTask silver_coro() {
   int processed = 0;
   int found_total = 0;
+  while (processed < NUM_SECTIONS) {
+    uint64_t t_wait = trace_begin();
+    Report rep = co_await co_channel.recv();
+    trace_end("wait", t_wait);
+    if (rep.group_id == 0)
+      break; // группы вышли раньше (Ctrl+C)
+    processed++;
+    silver_report(rep, processed, found_total);
+  }
+  silver_finish(found_total);
 
-  while (processed < NUM_SECTIONS && !g_terminate) {
-    // Ждём доклад
-    sem_wait(&sem_report);
+  // Докладов больше не будет: останавливаем пул
+  pthread_mutex_lock(&co_mutex);
+  co_stop = true;
+  pthread_cond_broadcast(&co_cond);
+  pthread_mutex_unlock(&co_mutex);
+}
+
+void *co_worker(void *arg) {
+  trace_thread("Пул " + to_string((long)arg));
+  pthread_mutex_lock(&co_mutex);
+  while (!co_stop) {
+    if (!co_ready.empty()) {
+      coroutine_handle<> h = co_ready.front();
+      co_ready.pop_front();
+      pthread_mutex_unlock(&co_mutex);
+      h.resume();
+      pthread_mutex_lock(&co_mutex);
+      continue;
+    }
+    pthread_cond_wait(&co_cond, &co_mutex);
+  }
+  pthread_mutex_unlock(&co_mutex);
+  return nullptr;
+}
 
-    // Берём один доклад
-    pthread_mutex_lock(&mutex_reports);
-    Report rep = reports[processed++];
-    pthread_mutex_unlock(&mutex_reports);
+// Запуск групп и Сильвера сопрограммами на пуле, возврат — когда Сильвер закончил
+void run_coroutines() {
+  pthread_cond_init(&co_cond, nullptr);
+  co_stop = false;
+  co_groups_alive = NUM_GROUPS;
+  co_channel.items.clear();
+  co_channel.waiter = nullptr;
 
-    if (rep.found)
-      found_total++;
+  // сопрограммы создаются остановленными (initial_suspend), запускает их пул
+  for (int i = 0; i < NUM_GROUPS; i++)
+    co_ready.push_back(group_coro(i + 1).handle);
+  co_ready.push_back(silver_coro().handle);
 
-    log_msg("[Сильвер] Доклад от группы " + to_string(rep.group_id) +
-            ": участок " + to_string(rep.section_id) + ", время " +
-            to_string(rep.search_time) + " ms, " +
-            (rep.found ? "СОКРОВИЩЕ НАЙДЕНО!" : "пусто"));
+  timer_wheel = new TimerWheel();
+  timer_wheel->start_ns = mono_ns();
+  pthread_t timer;
+  pthread_create(&timer, nullptr, timer_thread, nullptr);
+
+  vector<pthread_t> pool(co_pool_size);
+  for (int i = 0; i < co_pool_size; i++)
+    pthread_create(&pool[i], nullptr, co_worker, (void *)(long)(i + 1));
+  for (int i = 0; i < co_pool_size; i++)
+    pthread_join(pool[i], nullptr);
+
+  __atomic_store_n(&timer_wheel->stop, 1, __ATOMIC_RELEASE);
+  pthread_join(timer, nullptr);
+  timer_report(*timer_wheel);
+  delete timer_wheel;
+  timer_wheel = nullptr;
+  pthread_cond_destroy(&co_cond);
+}
+#endif
+
+// Один прогон поиска: группы, Сильвер, очистка. Возвращает время в секундах.
+double run_search() {
+  // Потоковый режим не заводит ни карты, ни массива докладов
+  if (g_stream && !g_simulate) {
+    g_stats = ExpeditionStats();
+    g_run_start_ns = mono_ns();
+    run_stream();
+    return (mono_ns() - g_run_start_ns) / 1e9;
+  }
+
+  // Подготовка данных
+  next_section = 0;
+  section_map = new uint64_t[section_words(NUM_SECTIONS)]();
+
+  g_stats = ExpeditionStats();
+  uint64_t t0 = mono_ns();
+  g_run_start_ns = t0;
+  if (g_simulate) {
+    run_simulation(g_seed);
+#if defined(__cpp_impl_coroutine)
+  } else if (g_coro) {
+    run_coroutines();
+#endif
+  } else if (g_spsc) {
+    Expedition<SpscSync> exp;
+    exp.run();
+    silver_wakeups = exp.sync.wakeups;
+  } else {
+    Expedition<MutexSemSync> exp;
+    exp.run();
   }
+  double elapsed = (mono_ns() - t0) / 1e9;
+
+  // Очистка
+  delete[] section_map;
+  section_map = nullptr;
+  return elapsed;
+}
+
+// Бенчмарк доставки докладов (--bench-queues): мьютекс + семафор против очередей SPSC.
+// Поиск без задержки, на группу per_group участков; прогоны по числу групп 2..512.
+void bench_queues(int per_group) {
+  const int group_counts[] = {2, 8, 32, 128, 512};
+  bool spsc_saved = g_spsc;
+  g_bench = true;
+  // заголовок выровнен вручную: printf считает ширину в байтах, а не в буквах
+  printf("%s\n", "  групп  участков    очередь      докл./с      перекл.   пробужд.");
+  for (int groups : group_counts) {
+    for (int mode = 0; mode < 2; mode++) {
+      NUM_GROUPS = groups;
+      NUM_SECTIONS = groups * per_group;
+      g_spsc = mode == 1;
+      long cs0 = context_switches();
+      double sec = run_search();
+      long cs = context_switches() - cs0;
+      // у семафора пробуждение — sem_post на каждый доклад
+      unsigned long long wakeups = g_spsc ? silver_wakeups : NUM_SECTIONS;
+      printf("%7d %9d %10s %12.0f %12ld %10llu\n", groups, NUM_SECTIONS,
+             g_spsc ? "spsc" : "mutex+sem", NUM_SECTIONS / sec, cs, wakeups);
+    }
+  }
+  g_spsc = spsc_saved;
+  g_bench = false;
+}
+
+// --check-sim R: после реального прогона — R симуляций с теми же параметрами
+// (зёрна подряд). Реальные показатели должны попасть в разброс симуляций: |z| <= 3.
+int check_simulation(int runs, const ExpeditionStats &real) {
+  struct Metric {
+    const char *name;
+    double (*get)(const ExpeditionStats &);
+  };
+  const Metric metrics[] = {
+      {"время экспедиции, с",
+       [](const ExpeditionStats &st) { return st.makespan_s; }},
+      {"среднее время поиска, мс",
+       [](const ExpeditionStats &st) {
+         return st.reports ? st.sum_search / st.reports : 0.0;
+       }},
+      {"найдено кладов",
+       [](const ExpeditionStats &st) { return (double)st.found; }},
+  };
+
+  vector<ExpeditionStats> sims;
+  bool simulate_saved = g_simulate;
+  uint64_t seed_saved = g_seed;
+  g_simulate = true;
+  g_silent = true;
+  uint64_t base = g_seed ? g_seed : (uint64_t)time(nullptr);
+  for (int r = 0; r < runs && !g_terminate; r++) {
+    g_seed = base + r;
+    run_search();
+    sims.push_back(g_stats);
+  }
+  g_silent = false;
+  g_simulate = simulate_saved;
+  g_seed = seed_saved;
+
+  printf("Проверка симуляции: %d прогонов, групп %d, участков %d\n",
+         (int)sims.size(), NUM_GROUPS, NUM_SECTIONS);
+  if (sims.empty()) {
+    // прервано (Ctrl+C) до первой симуляции: сравнивать не с чем
+    printf("Симуляции не выполнены, сравнение пропущено\n");
+    return 0;
+  }
+  bool all_ok = true;
+  for (const Metric &m : metrics) {
+    double sum = 0, sum2 = 0;
+    for (const ExpeditionStats &st : sims) {
+      double v = m.get(st);
+      sum += v;
+      sum2 += v * v;
+    }
+    double n = sims.size();
+    double mean = sum / n;
+    double sd = sqrt(max(0.0, sum2 / n - mean * mean));
+    double v = m.get(real);
+    // разброс из конечного числа симуляций может выйти нулевым: даём запас в 1%
+    double z = (v - mean) / max(sd, 0.01 * fabs(mean) + 1e-9);
+    bool ok = fabs(z) <= 3.0;
+    all_ok = all_ok && ok;
+    printf("  %s: реальный %.3f, симуляция %.3f ± %.3f, z = %+.2f %s\n", m.name,
+           v, mean, sd, z, ok ? "ок" : "РАСХОЖДЕНИЕ");
+  }
+  printf("%s\n", all_ok ? "Реальный прогон и симуляция согласуются"
+                         : "Реальный прогон и симуляция расходятся");
+  return all_ok ? 0 : 1;
+}
 
-  log_msg("[Сильвер] Работа завершена. Найдено кладов: " +
-          to_string(found_total));
+// Гистограмма с фиксированными корзинами на [lo, lo + width * n); выбросы — в крайние
+struct SweepHist {
+  double lo = 0, width = 1;
+  bool integer = false; // корзина — одно целое значение, квантиль — само значение
+  vector<long long> bins;
 
+  void init(double from, double to, int n) {
+    lo = from;
+    integer = (to - from) == n;
+    width = max((to - from) / n, 1e-9);
+    bins.assign(n, 0);
+  }
+  void add(double x) {
+    long k = (long)((x - lo) / width);
+    bins[min(max(k, 0L), (long)bins.size() - 1)]++;
+  }
+  void merge(const SweepHist &o) {
+    for (size_t k = 0; k < bins.size(); k++)
+      bins[k] += o.bins[k];
+  }
+  // квантиль с точностью до корзины (середина корзины)
+  double quantile(double q, long long total) const {
+    long long need = (long long)ceil(q * total), acc = 0;
+    for (size_t k = 0; k < bins.size(); k++) {
+      acc += bins[k];
+      if (acc >= max(need, 1LL))
+        return lo + (k + (integer ? 0.0 : 0.5)) * width;
+    }
+    return lo + bins.size() * width;
+  }
+};
+
+// Накопитель потока серии: суммы и гистограммы, сливаются в конце.
+// Выравнивание по строке кэша — чтобы потоки не делили строку со счётчиками соседа.
+struct alignas(64) SweepAcc {
+  long long runs = 0, with_treasure = 0;
+  double sum[3] = {}, sum2[3] = {}, lo[3], hi[3];
+  SweepHist hist[3];
+};
+
+// Показатели серии: время экспедиции, среднее время поиска, число кладов
+constexpr int SWEEP_METRICS = 3;
+const char *const sweep_names[SWEEP_METRICS] = {"время экспедиции, с",
+                                                "ср. время поиска, мс",
+                                                "найдено кладов"};
+
+void sweep_values(const ExpeditionStats &st, double v[SWEEP_METRICS]) {
+  v[0] = st.makespan_s;
+  v[1] = st.reports ? st.sum_search / st.reports : 0.0;
+  v[2] = (double)st.found;
+}
+
+// Пределы гистограмм — по пробной пачке: среднее ± 6σ, 1024 корзины
+// (у больших экспедиций разброс узкий, пределы по параметрам запуска дали бы
+// корзины шире σ). Выход за пределы учитывается в крайних корзинах, min/max точные.
+// Число кладов — по корзине на значение, если их не больше 1024.
+void sweep_hist_init(SweepAcc &acc, const double mean[], const double sd[]) {
+  for (int m = 0; m < SWEEP_METRICS; m++) {
+    double spread = max(6 * sd[m], 0.01 * fabs(mean[m]) + 1.0);
+    double from = max(0.0, mean[m] - spread), to = mean[m] + spread;
+    if (m == 2) {
+      from = floor(from);
+      to = ceil(to) + 1;
+      acc.hist[m].init(from, to, (int)min(to - from, 1024.0));
+    } else {
+      acc.hist[m].init(from, to, 1024);
+    }
+    acc.lo[m] = HUGE_VAL;
+    acc.hi[m] = -HUGE_VAL;
+  }
+}
+
+struct SweepJob {
+  long long runs;
+  uint64_t base_seed;
+  long long next;   // следующая экспедиция, раздаётся пачками
+  SweepAcc *accs;
+};
+constexpr long long SWEEP_CHUNK = 64;
+
+// Поток серии: берёт пачку номеров, экспедиция i идёт с зерном base + i.
+// Итог не зависит от числа потоков и порядка раздачи — только от base.
+void *sweep_worker(void *arg) {
+  auto *w = (pair<SweepJob *, int> *)arg;
+  SweepJob &job = *w->first;
+  SweepAcc &acc = job.accs[w->second];
+  for (;;) {
+    long long from = __atomic_fetch_add(&job.next, SWEEP_CHUNK, __ATOMIC_RELAXED);
+    if (from >= job.runs || g_terminate)
+      break;
+    long long to = min(from + SWEEP_CHUNK, job.runs);
+    for (long long i = from; i < to; i++) {
+      ExpeditionStats st = simulate_expedition(job.base_seed + i);
+      double v[SWEEP_METRICS];
+      sweep_values(st, v);
+      acc.runs++;
+      acc.with_treasure += st.found > 0;
+      for (int m = 0; m < SWEEP_METRICS; m++) {
+        acc.sum[m] += v[m];
+        acc.sum2[m] += v[m] * v[m];
+        acc.lo[m] = min(acc.lo[m], v[m]);
+        acc.hi[m] = max(acc.hi[m], v[m]);
+        acc.hist[m].add(v[m]);
+      }
+    }
+  }
   return nullptr;
 }
 
-void read_args_from_file(char *&arg) {
-  // Открываем файл, который содержит параметры
-  ifstream inFile(arg);
-  if (!inFile) {
-    cerr << "Ошибка открытия файла " << arg << endl;
-    exit(1);
+// -M N: серия из N симулированных экспедиций на threads потоках, итоговая таблица
+// (среднее, σ, 95% доверительный интервал среднего, квантили) и гистограмма кладов
+void run_sweep(long long runs, int threads) {
+  uint64_t base = g_seed ? g_seed : (uint64_t)time(nullptr);
+  SweepJob job = {runs, base, 0, new SweepAcc[threads]};
+  vector<pair<SweepJob *, int>> args(threads);
+  vector<pthread_t> tids(threads);
+  double mean[SWEEP_METRICS] = {}, sd[SWEEP_METRICS] = {};
+  long long pilot = min(runs, 32LL);
+  for (long long i = 0; i < pilot; i++) {
+    double v[SWEEP_METRICS];
+    sweep_values(simulate_expedition(base + i), v);
+    for (int m = 0; m < SWEEP_METRICS; m++) {
+      mean[m] += v[m] / pilot;
+      sd[m] += v[m] * v[m] / pilot;
+    }
   }
+  for (int m = 0; m < SWEEP_METRICS; m++)
+    sd[m] = sqrt(max(0.0, sd[m] - mean[m] * mean[m]));
+  for (int t = 0; t < threads; t++)
+    sweep_hist_init(job.accs[t], mean, sd);
 
-  vector<string> params;
-  string token;
-  while (inFile >> token) {
-    params.push_back(token);
+  uint64_t t0 = mono_ns();
+  for (int t = 0; t < threads; t++) {
+    args[t] = {&job, t};
+    pthread_create(&tids[t], nullptr, sweep_worker, &args[t]);
   }
-  if (params.size() < 2 || params.size() > 3) {
-    cerr << "Ошибка структуры входного файла: " << arg
-         << " <кол-во групп> <кол-во участков> [файл для вывода]" << endl;
-    exit(1);
+  for (int t = 0; t < threads; t++)
+    pthread_join(tids[t], nullptr);
+  double elapsed = (mono_ns() - t0) / 1e9;
+
+  SweepAcc &total = job.accs[0];
+  for (int t = 1; t < threads; t++) {
+    const SweepAcc &a = job.accs[t];
+    total.runs += a.runs;
+    total.with_treasure += a.with_treasure;
+    for (int m = 0; m < SWEEP_METRICS; m++) {
+      total.sum[m] += a.sum[m];
+      total.sum2[m] += a.sum2[m];
+      total.lo[m] = min(total.lo[m], a.lo[m]);
+      total.hi[m] = max(total.hi[m], a.hi[m]);
+      total.hist[m].merge(a.hist[m]);
+    }
   }
-  NUM_GROUPS = stoi(params[0]);
-  NUM_SECTIONS = stoi(params[1]);
 
-  // Закрывай файл
-  if (inFile) {
-    inFile.close();
+  long long n = total.runs;
+  printf("Серия: %lld экспедиций (зёрна %llu..%llu), групп %d, участков %d, "
+         "вероятность клада %.3f\n",
+         n, (unsigned long long)base, (unsigned long long)(base + n - 1),
+         NUM_GROUPS, NUM_SECTIONS, TREASURE_PROB);
+  printf("Потоков %d, %.2f с, %.0f экспедиций/с\n", threads, elapsed,
+         n / elapsed);
+  if (n == 0) {
+    delete[] job.accs;
+    return;
   }
-  if (params.size() == 3) {
-    outFile.open(params[2]);
-    if (!outFile) {
-      cerr << "Ошибка открытия файла для вывода " << params[2] << endl;
-      exit(1);
+  // заголовок выровнен вручную: printf считает ширину в байтах, а не в буквах
+  printf("%s\n", "  показатель             среднее        σ       95% ДИ среднего"
+                 "          p5        p50        p95        min        max");
+  for (int m = 0; m < SWEEP_METRICS; m++) {
+    double mean = total.sum[m] / n;
+    double sd = sqrt(max(0.0, total.sum2[m] / n - mean * mean) * n /
+                     max(n - 1, 1LL));
+    double half = 1.96 * sd / sqrt((double)n);
+    printf("  %s", sweep_names[m]);
+    // дополнение до 21 буквы: кириллица занимает два байта
+    int letters = 0;
+    for (const char *c = sweep_names[m]; *c; c++)
+      letters += (*c & 0xC0) != 0x80;
+    printf("%*s", max(21 - letters, 1), "");
+    printf("%9.3f %8.3f [%9.3f; %9.3f] %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+           mean, sd, mean - half, mean + half, total.hist[m].quantile(0.05, n),
+           total.hist[m].quantile(0.5, n), total.hist[m].quantile(0.95, n),
+           total.lo[m], total.hi[m]);
+  }
+  double p = (double)total.with_treasure / n;
+  double half = 1.96 * sqrt(p * (1 - p) / n);
+  printf("  P(хотя бы один клад) = %.4f, 95%% ДИ [%.4f; %.4f]\n", p,
+         max(0.0, p - half), min(1.0, p + half));
+
+  // гистограмма кладов: по корзине на значение, корзина k — это h.lo + k кладов;
+  // пустые корзины по краям не печатаются, выбросы лежат в крайних (≤ и ≥)
+  const SweepHist &h = total.hist[2];
+  if (h.integer) {
+    printf("Распределение числа кладов:\n");
+    int first = 0, last = (int)h.bins.size() - 1;
+    while (first < last && h.bins[first] == 0)
+      first++;
+    while (last > first && h.bins[last] == 0)
+      last--;
+    long long peak = *max_element(h.bins.begin(), h.bins.end());
+    for (int k = first; k <= last; k++) {
+      long long value = (long long)h.lo + k;
+      const char *mark = k == 0 && total.lo[2] < value                 ? "≤"
+                         : k == (int)h.bins.size() - 1 && total.hi[2] > value ? "≥"
+                                                                       : " ";
+      int bar = peak ? (int)(50 * h.bins[k] / peak) : 0;
+      printf(" %s%4lld %8lld %6.2f%% %s\n", mark, value, h.bins[k],
+             100.0 * h.bins[k] / n, string(bar, '#').c_str());
     }
   }
+  delete[] job.accs;
 }
 
 int main(int argc, char *argv[]) {
+  string archive_path;
+  string trace_path;
+  int bench_per_group = 0;
+  int check_runs = 0;
+  long long sweep_runs = 0;
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int sweep_threads = cores > 0 ? (int)cores : 1;
   for (int i = 1; i < argc; ++i) {
     string arg = argv[i];
     if (arg == "-g" || arg == "--groups") {
       NUM_GROUPS = stoi(argv[++i]);
     } else if (arg == "-s" || arg == "--sections") {
-      NUM_SECTIONS = stoi(argv[++i]);
+      g_stream_sections = stoll(argv[++i]);
+      NUM_SECTIONS = (int)min(g_stream_sections, (long long)INT_MAX);
     } else if (arg == "-i" || arg == "--input-file") {
       read_args_from_file(argv[++i]);
+      g_stream_sections = NUM_SECTIONS;
       break;
+    } else if (arg == "-t" || arg == "--trace") {
+      trace_path = argv[++i];
+      g_trace = true;
+    } else if (arg == "-c" || arg == "--coro") {
+#if defined(__cpp_impl_coroutine)
+      g_coro = true;
+      long cores = sysconf(_SC_NPROCESSORS_ONLN);
+      co_pool_size = cores > 0 ? (int)cores : 1;
+      if (i + 1 < argc && argv[i + 1][0] != '-')
+        co_pool_size = stoi(argv[++i]);
+#else
+      cerr << "Режим сопрограмм недоступен: соберите с -std=c++20" << endl;
+      return 1;
+#endif
+    } else if (arg == "-q" || arg == "--spsc") {
+      g_spsc = true;
+    } else if (arg == "-S" || arg == "--simulate") {
+      g_simulate = true;
+    } else if (arg == "--seed") {
+      g_seed = stoull(argv[++i]);
+    } else if (arg == "-M" || arg == "--sweep") {
+      sweep_runs = stoll(argv[++i]);
+    } else if (arg == "-j" || arg == "--threads") {
+      sweep_threads = max(1, stoi(argv[++i]));
+    } else if (arg == "--stream") {
+      g_stream = true;
+      if (i + 1 < argc && argv[i + 1][0] != '-')
+        g_stream_capacity = max(1, stoi(argv[++i]));
+    } else if (arg == "--no-search") {
+      g_no_search = true;
+    } else if (arg == "--quiet") {
+      g_quiet = true;
+    } else if (arg == "--check-sim") {
+      check_runs = 200;
+      if (i + 1 < argc && argv[i + 1][0] != '-')
+        check_runs = stoi(argv[++i]);
+    } else if (arg == "-b" || arg == "--bench-queues") {
+      bench_per_group = 2000;
+      if (i + 1 < argc && argv[i + 1][0] != '-')
+        bench_per_group = stoi(argv[++i]);
+    } else if (arg == "-a" || arg == "--archive") {
+      archive_path = argv[++i];
     } else if (arg == "-o" || arg == "--output-file") {
       outFile.open(argv[++i]);
       if (!outFile) {
@@ -189,55 +1143,74 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  if (NUM_GROUPS <= 0 || NUM_SECTIONS <= 0 || NUM_GROUPS >= NUM_SECTIONS) {
+  if (bench_per_group > 0) {
+    bench_queues(bench_per_group);
+    return 0;
+  }
+
+  if (g_stream_sections == 0)
+    g_stream_sections = NUM_SECTIONS;
+  if (NUM_GROUPS <= 0 || g_stream_sections <= 0 ||
+      NUM_GROUPS >= g_stream_sections) {
     cerr << "Ошибка: число групп должно быть > 0 и < числа участков." << endl;
     return 1;
   }
+  if (g_stream_sections > INT_MAX && !g_stream) {
+    cerr << "Больше " << INT_MAX << " участков — только с --stream" << endl;
+    return 1;
+  }
+  if (g_stream && (!archive_path.empty() || g_trace)) {
+    // архив и трасса растут с числом докладов
+    cerr << "В режиме --stream архив и трасса не ведутся" << endl;
+    archive_path.clear();
+    g_trace = false;
+  }
 
   signal(SIGTERM, sigint_handler);
   signal(SIGINT, sigint_handler);
 
-  // Инициализация генератора случайных чисел
-  srand(time(nullptr));
-
-  // Подготовка данных
-  section_taken = new int[NUM_SECTIONS]();
-  reports = new Report[NUM_SECTIONS];
-  reports_count = 0;
-
-  pthread_mutex_init(&mutex_alloc, nullptr);
-  pthread_mutex_init(&mutex_reports, nullptr);
-  sem_init(&sem_report, 0, 0);
-
-  // Создаём потоки групп
-  pthread_t *threads = new pthread_t[NUM_GROUPS];
-  for (int i = 0; i < NUM_GROUPS; i++) {
-    pthread_create(&threads[i], nullptr, group_thread, (void *)(long)(i + 1));
+  if (sweep_runs > 0) {
+    run_sweep(sweep_runs, sweep_threads);
+    return 0;
   }
 
-  // Управляющий поток (Сильвер)
-  pthread_t silver_thread;
-  pthread_create(&silver_thread, nullptr, silver_manager, nullptr);
+  // Зерно запуска: с ним прогон повторяет те же времена поиска и находки
+  if (g_seed == 0)
+    g_seed = (uint64_t)time(nullptr);
 
-  // Ждём завершения всех групп
-  for (int i = 0; i < NUM_GROUPS; i++) {
-    pthread_join(threads[i], nullptr);
+  if (!archive_path.empty() &&
+      !archive_open(archive, archive_path, NUM_SECTIONS, NUM_SECTIONS,
+                    NUM_GROUPS, 4)) {
+    cerr << "Архив " << archive_path << " недоступен, доклады не архивируются"
+         << endl;
   }
 
-  // Ждём завершения Сильвера
-  pthread_join(silver_thread, nullptr);
+  log_start();
+  log_msg("Зерно запуска: %llu (повтор: --seed %llu)",
+          (unsigned long long)g_seed, (unsigned long long)g_seed);
+  double elapsed = run_search();
+  log_stop();
+  if (g_simulate)
+    printf("Симуляция (зерно %llu): виртуальное время %.1f с, реальное %.2f с\n",
+           (unsigned long long)g_seed, g_stats.makespan_s, elapsed);
 
-  // Очистка
-  sem_destroy(&sem_report);
-  pthread_mutex_destroy(&mutex_alloc);
-  pthread_mutex_destroy(&mutex_reports);
-  delete[] section_taken;
-  delete[] reports;
-  delete[] threads;
+  archive_close(archive);
+  int status = 0;
+  if (check_runs > 0 && !g_simulate) {
+    ExpeditionStats real = g_stats;
+    status = check_simulation(check_runs, real);
+  }
+  if (g_trace) {
+    if (trace_save(trace_path))
+      cout << "Трасса сохранена в " << trace_path
+           << " (chrome://tracing, ui.perfetto.dev)" << endl;
+    else
+      cerr << "Не удалось записать трассу " << trace_path << endl;
+  }
 
   if (outFile) {
     outFile.close();
   }
 
-  return 0;
+  return status;
 }